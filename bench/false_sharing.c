@@ -0,0 +1,169 @@
+// active and passive false sharing, as in the cache-thrash
+// and cache-scratch benchmarks, as csv on stdout
+//
+//     build/bench/false_sharing [-t threads] [-n objects] [-w writes] [-s 0|1]
+//
+//     -t  most threads to run with
+//     -n  objects each thread allocates, writes and frees
+//     -w  writes to every byte of each object
+//     -s  whether threads get blocks of their own,
+//         run once with each to compare
+//
+// thrash has every thread allocate its own objects, which
+// without segregation are placed next to those of other
+// threads. scratch first has every thread free an object
+// the main thread allocated next to the others, which
+// without segregation the thread is then given back.
+
+#include <custom_mem/malloc.h>
+#include <pthread.h>
+#include <stdio.h>  // printf
+#include <stdlib.h> // calloc, strtoull
+#include <time.h>   // clock_gettime
+#include <unistd.h> // getopt, sysconf
+
+#define OBJ_SZ 8
+
+static size_t objects = 1000;
+static size_t writes  = 10000;
+
+static pthread_barrier_t barrier;
+
+struct Thread
+{
+    pthread_t thread;
+
+    // freed first if not NULL
+    void*     given;
+
+    double    begin;
+    double    end;
+};
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+static void* start(void* arg)
+{
+    struct Thread* thread = arg;
+
+    pthread_barrier_wait(&barrier);
+    thread->begin = now();
+
+    my_free(thread->given);
+
+    for (size_t i = 0; i != objects; ++i)
+    {
+        volatile char* obj = my_malloc(OBJ_SZ);
+
+        for (size_t j = 0; j != writes; ++j)
+        {
+            for (size_t k = 0; k != OBJ_SZ; ++k)
+            {
+                ++obj[k];
+            }
+        }
+
+        my_free((void*)obj);
+    }
+
+    thread->end = now();
+
+    return NULL;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t segregate = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "t:n:w:s:")) != -1)
+    {
+        switch (opt)
+        {
+            case 't':
+                max_threads = strtoull(optarg, NULL, 0);
+                break;
+            case 'n':
+                objects = strtoull(optarg, NULL, 0);
+                break;
+            case 'w':
+                writes = strtoull(optarg, NULL, 0);
+                break;
+            case 's':
+                segregate = strtoull(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-t threads] [-n objects] [-w writes] [-s 0|1]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    my_mallopt(MY_M_SEGREGATE, segregate);
+
+    struct Thread* threads = calloc(max_threads, sizeof(struct Thread));
+    if (!threads)
+    {
+        return 1;
+    }
+
+    printf("workload,segregate,threads,objects,seconds\n");
+
+    for (int scratch = 0; scratch != 2; ++scratch)
+    {
+        for (size_t num = 1; num <= max_threads; ++num)
+        {
+            pthread_barrier_init(&barrier, NULL, num);
+
+            for (size_t i = 0; i != num; ++i)
+            {
+                threads[i].given = scratch ? my_malloc(OBJ_SZ) : NULL;
+            }
+
+            for (size_t i = 0; i != num; ++i)
+            {
+                if (pthread_create(&threads[i].thread, NULL, start, &threads[i]))
+                {
+                    return 1;
+                }
+            }
+
+            for (size_t i = 0; i != num; ++i)
+            {
+                pthread_join(threads[i].thread, NULL);
+            }
+
+            // from the first thread starting to the last done
+            double begin = threads[0].begin;
+            double end = threads[0].end;
+            for (size_t i = 1; i != num; ++i)
+            {
+                begin = threads[i].begin < begin ? threads[i].begin : begin;
+                end = threads[i].end > end ? threads[i].end : end;
+            }
+
+            pthread_barrier_destroy(&barrier);
+
+            printf
+            (
+                "%s,%zu,%zu,%zu,%.6f\n",
+                scratch ? "scratch" : "thrash",
+                segregate,
+                num,
+                num * objects,
+                end - begin
+            );
+            fflush(stdout);
+        }
+    }
+
+    free(threads);
+
+    return 0;
+}
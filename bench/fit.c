@@ -0,0 +1,150 @@
+// time every fit policy over a few size distributions
+// and report how fragmented each leaves its heap
+//
+//     build/bench/fit [calls] [live]
+//
+// peak is the most bytes mapped at once, frag the
+// share of bytes in blocks not handed out and hole
+// the share of free bytes outside the largest free
+// space of their block, both at the end
+
+#include <custom_mem/malloc.h>
+#include <stdio.h>  // printf
+#include <stdlib.h> // strtoull, rand
+#include <string.h> // memset
+#include <time.h>   // clock_gettime
+
+struct Dist
+{
+    const char* name;
+    size_t    (*size)(size_t);
+};
+
+static size_t small(size_t call)
+{
+    // uniform over the size classes
+
+    return 16 + (rand() % 1009);
+}
+
+static size_t mixed(size_t call)
+{
+    // mostly small, some a few pages
+
+    return rand() % 10 ? 16 + (rand() % 241) : 4096 + (rand() % 28673);
+}
+
+static size_t bimodal(size_t call)
+{
+    // two sizes, which leaves holes only the
+    // smaller one fits
+
+    return rand() % 2 ? 48 : 3000;
+}
+
+static size_t growing(size_t call)
+{
+    // sizes creep up over time, like buffers
+    // being resized
+
+    return 16 + ((call / 8) % 4096);
+}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+int main(int argc, char const *argv[])
+{
+    size_t calls = argc > 1 ? strtoull(argv[1], NULL, 0) : 50000;
+    size_t live  = argc > 2 ? strtoull(argv[2], NULL, 0) : 512;
+
+    static const struct Dist dists[] =
+    {
+        { "small",   small   },
+        { "mixed",   mixed   },
+        { "bimodal", bimodal },
+        { "growing", growing }
+    };
+
+    static const char* fits[] = { "first", "best", "next", "lifo", "lowest" };
+
+    char** ptrs = calloc(live, sizeof(char*));
+    if (!ptrs)
+    {
+        return -1;
+    }
+
+    printf("%-8s %-6s %10s %10s %8s %8s\n", "dist", "fit", "ns/call", "peak", "frag", "hole");
+
+    for (size_t d = 0; d != sizeof(dists) / sizeof(dists[0]); ++d)
+    {
+        for (size_t f = 0; f != sizeof(fits) / sizeof(fits[0]); ++f)
+        {
+            my_mallopt(MY_M_FIT, f);
+            srand(1);
+
+            struct MallocHeap* heap = my_heap_create();
+            struct MallocStats stats;
+            size_t peak = 0;
+
+            double start = now();
+
+            for (size_t i = 0; i != calls; ++i)
+            {
+                size_t slot = rand() % live;
+
+                my_heap_free(heap, ptrs[slot]);
+
+                size_t bytes = dists[d].size(i);
+                ptrs[slot] = my_heap_malloc(heap, bytes);
+                ptrs[slot][0] = 1;
+
+                if (!(i % 1024))
+                {
+                    my_heap_stats(heap, &stats);
+                    if (stats.mapped > peak)
+                    {
+                        peak = stats.mapped;
+                    }
+                }
+            }
+
+            double elapsed = now() - start;
+
+            my_heap_stats(heap, &stats);
+
+            double frag = (double)stats.free / (stats.free + stats.in_use);
+
+            // free space split into holes too small to use
+            double hole = stats.free ? 1 - ((double)stats.free_max / stats.free) : 0;
+
+            printf
+            (
+                "%-8s %-6s %10.1f %10zu %8.3f %8.3f\n",
+                dists[d].name,
+                fits[f],
+                (elapsed * 1e9) / calls,
+                peak,
+                frag,
+                hole
+            );
+
+            for (size_t i = 0; i != live; ++i)
+            {
+                my_heap_free(heap, ptrs[i]);
+                ptrs[i] = NULL;
+            }
+
+            my_heap_destroy(heap);
+        }
+    }
+
+    free(ptrs);
+
+    return 0;
+}
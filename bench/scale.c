@@ -0,0 +1,307 @@
+// throughput and rss of a few workloads as the number
+// of threads goes from 1 to twice the number of cpus,
+// as csv on stdout
+//
+//     build/bench/scale [-a my|libc] [-t threads] [-n ops] [-p]
+//
+//     -a  allocator to use, run once with each to compare
+//     -t  most threads to run with
+//     -n  operations per thread
+//     -p  pin thread i to cpu i modulo the number of cpus
+
+#define _GNU_SOURCE // pthread_setaffinity_np
+
+#include <custom_mem/malloc.h>
+#include <pthread.h>
+#include <sched.h>     // cpu_set_t
+#include <stdatomic.h>
+#include <stdio.h>     // printf
+#include <stdlib.h>    // malloc, strtoull
+#include <string.h>    // strcmp
+#include <time.h>      // clock_gettime
+#include <unistd.h>    // getopt, sysconf
+
+#define NUM_LOCAL  256
+#define NUM_SHARED 4096
+#define NUM_GROW   16
+#define GROW_MAX   65536
+
+struct Alloc
+{
+    const char* name;
+    void*     (*malloc)(size_t);
+    void      (*free)(void*);
+    void*     (*realloc)(void*, size_t);
+};
+
+static const struct Alloc allocs[] =
+{
+    { "my",   my_malloc, my_free, my_realloc },
+    { "libc", malloc,    free,    realloc    }
+};
+
+static const struct Alloc* alloc = &allocs[0];
+
+static size_t ops = 200000;
+static int    pin;
+static long   cpus;
+
+static pthread_barrier_t barrier;
+
+// slots every thread allocates into and frees from
+static void* _Atomic shared[NUM_SHARED];
+
+static size_t next(size_t* seed)
+{
+    *seed = (*seed * 6364136223846793005u) + 1442695040888963407u;
+
+    return *seed >> 33;
+}
+
+static void local(size_t seed)
+{
+    // allocate and free within the thread
+
+    void* ptrs[NUM_LOCAL] = { NULL };
+
+    for (size_t i = 0; i != ops; ++i)
+    {
+        size_t slot = next(&seed) % NUM_LOCAL;
+
+        alloc->free(ptrs[slot]);
+        ptrs[slot] = alloc->malloc(16 + (next(&seed) % 512));
+        *(char*)ptrs[slot] = 1;
+    }
+
+    for (size_t i = 0; i != NUM_LOCAL; ++i)
+    {
+        alloc->free(ptrs[i]);
+    }
+}
+
+static void remote(size_t seed)
+{
+    // free what other threads allocated
+
+    for (size_t i = 0; i != ops; ++i)
+    {
+        void* ptr = alloc->malloc(16 + (next(&seed) % 512));
+        *(char*)ptr = 1;
+
+        alloc->free(atomic_exchange(&shared[next(&seed) % NUM_SHARED], ptr));
+    }
+}
+
+static void grow(size_t seed)
+{
+    // grow buffers with realloc until they are
+    // large, then start them over
+
+    void* ptrs[NUM_GROW] = { NULL };
+    size_t sizes[NUM_GROW] = { 0 };
+
+    for (size_t i = 0; i != ops; ++i)
+    {
+        size_t slot = next(&seed) % NUM_GROW;
+
+        if (sizes[slot] >= GROW_MAX)
+        {
+            alloc->free(ptrs[slot]);
+            ptrs[slot] = NULL;
+            sizes[slot] = 0;
+        }
+
+        sizes[slot] += 16 + (sizes[slot] / 2);
+        ptrs[slot] = alloc->realloc(ptrs[slot], sizes[slot]);
+        ((char*)ptrs[slot])[sizes[slot] - 1] = 1;
+    }
+
+    for (size_t i = 0; i != NUM_GROW; ++i)
+    {
+        alloc->free(ptrs[i]);
+    }
+}
+
+struct Workload
+{
+    const char* name;
+    void      (*run)(size_t);
+};
+
+static const struct Workload workloads[] =
+{
+    { "local",  local  },
+    { "remote", remote },
+    { "grow",   grow   }
+};
+
+struct Thread
+{
+    pthread_t thread;
+    size_t    index;
+    void    (*run)(size_t);
+
+    /*  When the thread started and finished its
+        work, the main thread may not run between
+        the two.
+    */
+    double    begin;
+    double    end;
+};
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+static void* start(void* arg)
+{
+    struct Thread* thread = arg;
+
+    if (pin)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(thread->index % cpus, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+    pthread_barrier_wait(&barrier);
+    thread->begin = now();
+    thread->run(thread->index + 1);
+    thread->end = now();
+
+    return NULL;
+}
+
+static size_t rss_kb()
+{
+    // resident set size of the process
+
+    size_t pages = 0;
+    size_t resident = 0;
+
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (statm)
+    {
+        if (fscanf(statm, "%zu %zu", &pages, &resident) != 2)
+        {
+            resident = 0;
+        }
+        fclose(statm);
+    }
+
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+int main(int argc, char* argv[])
+{
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t max_threads = 2 * cpus;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "a:t:n:p")) != -1)
+    {
+        switch (opt)
+        {
+            case 'a':
+                alloc = NULL;
+                for (size_t i = 0; i != sizeof(allocs) / sizeof(allocs[0]); ++i)
+                {
+                    if (!strcmp(optarg, allocs[i].name))
+                    {
+                        alloc = &allocs[i];
+                    }
+                }
+                if (!alloc)
+                {
+                    fprintf(stderr, "unknown allocator %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 't':
+                max_threads = strtoull(optarg, NULL, 0);
+                break;
+            case 'n':
+                ops = strtoull(optarg, NULL, 0);
+                break;
+            case 'p':
+                pin = 1;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-a my|libc] [-t threads] [-n ops] [-p]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    struct Thread* threads = calloc(max_threads, sizeof(struct Thread));
+    if (!threads)
+    {
+        return 1;
+    }
+
+    printf("workload,allocator,threads,ops,seconds,ops_per_sec,rss_kb\n");
+
+    for (size_t w = 0; w != sizeof(workloads) / sizeof(workloads[0]); ++w)
+    {
+        for (size_t num = 1; num <= max_threads; ++num)
+        {
+            pthread_barrier_init(&barrier, NULL, num);
+
+            for (size_t i = 0; i != num; ++i)
+            {
+                threads[i].index = i;
+                threads[i].run = workloads[w].run;
+                if (pthread_create(&threads[i].thread, NULL, start, &threads[i]))
+                {
+                    return 1;
+                }
+            }
+
+            for (size_t i = 0; i != num; ++i)
+            {
+                pthread_join(threads[i].thread, NULL);
+            }
+
+            // from the first thread starting to the last done
+            double begin = threads[0].begin;
+            double end = threads[0].end;
+            for (size_t i = 1; i != num; ++i)
+            {
+                begin = threads[i].begin < begin ? threads[i].begin : begin;
+                end = threads[i].end > end ? threads[i].end : end;
+            }
+            double seconds = end - begin;
+
+            size_t rss = rss_kb();
+
+            pthread_barrier_destroy(&barrier);
+
+            printf
+            (
+                "%s,%s,%zu,%zu,%.6f,%.0f,%zu\n",
+                workloads[w].name,
+                alloc->name,
+                num,
+                num * ops,
+                seconds,
+                (num * ops) / seconds,
+                rss
+            );
+            fflush(stdout);
+        }
+
+        // do not carry one workload's leftovers into the next
+        for (size_t i = 0; i != NUM_SHARED; ++i)
+        {
+            alloc->free(atomic_exchange(&shared[i], NULL));
+        }
+    }
+
+    free(threads);
+
+    return 0;
+}
@@ -1,18 +1,334 @@
 #pragma once
 #include <stddef.h>
 #include <time.h>
+#include <custom_mem/size_classes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 struct MallocAdjustables
 {
     /* Minimum amount of more memory to request at a time.
+       A multiple of the page size.
     */
     size_t more_mem;
 
     /*  Global waiting time. 
     */
     struct timespec long_wait;
+
+    /*  Number of pause instructions in one short wait.
+    */
+    size_t short_wait;
+
+    /*  Allocations of atleast this many bytes get
+        their own mapping, which is unmapped on free.
+    */
+    size_t large_sz;
+
+    /*  Freed allocations of atleast this many bytes
+        have their pages given back. 0 disables.
+    */
+    size_t trim_sz;
+
+    /*  Most allocations each thread keeps cached
+        per size class. 0 disables the cache.
+    */
+    size_t cache_sz;
+
+    /*  Number of heaps my_malloc spreads threads
+        over. Atmost 64.
+    */
+    size_t arenas;
+
+    /*  One in this many my_malloc calls is put on a
+        page between inaccessible pages, to catch
+        out of bounds and use after free accesses.
+        0 disables.
+    */
+    size_t guard_rate;
+
+    /*  Number of pages for sampled allocations. Can
+        not change once one has been made.
+    */
+    size_t guard_slots;
+
+    /*  MY_MALLOC_FIT_* placement policy.
+    */
+    size_t fit;
+
+    /*  Whether to time operations and waits, see
+        my_malloc_latency.
+    */
+    size_t profile;
+
+    /*  Mappings of a heap double in size with the
+        bytes it has mapped, up to this many bytes.
+        Atmost more_mem disables growing.
+    */
+    size_t grow_max;
+
+    /*  Bytes of address space to reserve up front
+        for every heap to map from. 0 maps each
+        mapping on its own. Can only be set before
+        the first mapping.
+    */
+    size_t reserve_sz;
+
+    /*  Most batches of cache_sz / 2 allocations kept
+        per size class to move between the caches of
+        threads. Atmost 64, 0 disables.
+    */
+    size_t transfer_sz;
+
+    /*  Milliseconds free space and batches of the
+        transfer cache must sit idle before a
+        background thread gives them back. Setting
+        it starts the thread. A thread gives back
+        what sat in its cache as long on its next
+        free. 0 disables.
+    */
+    size_t decay_ms;
+
+    /*  Whether each thread puts its small my_malloc
+        allocations in blocks of its own, so threads
+        never share the cache lines of their objects.
+        Thread caches then skip the transfer cache.
+    */
+    size_t segregate;
+
+    /*  Frees a block lets pile up before merging
+        the free space next to each, merged sooner
+        when an allocation finds no room. Most
+        frees then take the same time no matter
+        how many nodes their block has. 0 merges on
+        every free.
+    */
+    size_t coalesce;
+
+    /*  Milliseconds between writes of the statistics
+        of the heaps used by my_malloc to shared memory,
+        see MallocShared. Setting it starts a thread
+        which writes them. 0 stops writing.
+    */
+    size_t publish_ms;
+};
+
+/*  Statistics of a heap.
+*/
+struct MallocStats
+{
+    /*  Bytes currently mapped.
+    */
+    size_t mapped;
+
+    /*  Bytes handed out and not yet freed, not
+        counting meta data. Allocations sitting in
+        a thread cache count as handed out.
+    */
+    size_t in_use;
+
+    /*  Bytes free inside of blocks.
+    */
+    size_t free;
+
+    /*  Sum of the largest free space of every
+        block. The closer to free, the less the
+        free bytes are split into holes.
+    */
+    size_t free_max;
+
+    /*  Times a thread found a block taken when it
+        tried to allocate from it, and times one
+        spun on a block waiting to free or resize.
+    */
+    size_t block_fails;
+    size_t block_spins;
+
+    /*  Times a free found its block taken and left
+        the allocation for the thread holding it.
+    */
+    size_t block_deferred;
+
+    /*  Frees waiting to be merged, see coalesce.
+    */
+    size_t block_pending;
+
+    /*  Times a thread found the mappings of a heap
+        taken and had to sleep.
+    */
+    size_t heap_fails;
+
+    /*  Number of mmap and munmap calls made.
+    */
+    size_t num_mmap;
+    size_t num_munmap;
+
+    /*  Bytes waiting in the transfer cache to go to
+        another thread, also counted in in_use. Only
+        for the heaps used by my_malloc.
+    */
+    size_t transfer;
+
+    /*  Bytes of idle free space given back by the
+        decay thread so far.
+    */
+    size_t purged;
+};
+
+/*  Latency of one kind of operation over every
+    thread, in nanoseconds. Percentiles are the
+    upper end of the histogram bucket they fall
+    in, which is atmost an eighth too high.
+*/
+struct MallocLatency
+{
+    size_t count;
+    size_t p50;
+    size_t p99;
+    size_t p999;
+    size_t max;
+};
+
+/*  Kinds of operation timed while profile is set.
+
+    MALLOC      my_malloc, my_free, my_calloc and
+    FREE        my_realloc, not counting the inline
+    CALLOC      fast path of my_malloc_inline
+    REALLOC
+    ACQUIRE     finding another block after the block
+                found was taken by another thread
+    SHORT       one _wait_short, spinning on a block
+    LONG        one _wait_long, sleeping on a heap
+    MMAP        one mmap or munmap of heap memory
+*/
+#define MY_MALLOC_LAT_MALLOC  0
+#define MY_MALLOC_LAT_FREE    1
+#define MY_MALLOC_LAT_CALLOC  2
+#define MY_MALLOC_LAT_REALLOC 3
+#define MY_MALLOC_LAT_ACQUIRE 4
+#define MY_MALLOC_LAT_SHORT   5
+#define MY_MALLOC_LAT_LONG    6
+#define MY_MALLOC_LAT_MMAP    7
+#define MY_MALLOC_LAT_KINDS   8
+
+/*  Statistics written to a shared memory segment
+    while publish_ms is set, for another process to
+    read without stopping or calling into this one,
+    see tools/heap_stats. The segment is named
+    MY_MALLOC_SHARED_NAME with the pid of the writing
+    process, and removed when it exits.
+
+    Written under a seqlock. seq is odd while the rest
+    is being written. A reader copies the segment and
+    keeps the copy only if seq was even and the same
+    before and after.
+*/
+#define MY_MALLOC_SHARED_NAME    "/my_malloc.%ld"
+#define MY_MALLOC_SHARED_MAGIC   0x6d796d61
+#define MY_MALLOC_SHARED_VERSION 1
+
+struct MallocShared
+{
+    unsigned magic;
+    unsigned version;
+
+    size_t seq;
+
+    long   pid;
+
+    /*  Times written, and CLOCK_REALTIME nanoseconds
+        of the last.
+    */
+    size_t updates;
+    size_t time_ns;
+
+    /*  Every heap used by my_malloc, as given by
+        my_heap_stats, but read from counters without
+        stopping any thread, so they may not agree
+        while allocating. free also counts the meta
+        data of free nodes.
+    */
+    struct MallocStats stats;
+
+    /*  Size of each class, small requests made for
+        each while profile is set, and allocations of
+        each waiting in the transfer cache.
+    */
+    size_t num_classes;
+    size_t class_sz[MY_MALLOC_NUM_CLASSES];
+    size_t class_requests[MY_MALLOC_NUM_CLASSES];
+    size_t class_transfer[MY_MALLOC_NUM_CLASSES];
+};
+
+/*  Per thread free lists of small allocations, one
+    per size class. Cached allocations are linked
+    through their first bytes.
+
+    Only here so my_malloc_inline can be inlined.
+*/
+struct MallocThreadCache
+{
+    void*  head[MY_MALLOC_NUM_CLASSES];
+    size_t count[MY_MALLOC_NUM_CLASSES];
+
+    // fewest cached since last trimmed
+    size_t low[MY_MALLOC_NUM_CLASSES];
 };
 
+extern __thread struct MallocThreadCache my_malloc_tcache;
+
+/*  Parameters for my_mallopt. Can also be set with the
+    MY_MALLOC_CONF environment variable as a comma
+    seperated list of name:value, using the names below.
+        ie
+        MY_MALLOC_CONF="more_mem:4194304,large:262144"
+*/
+#define MY_M_MORE_MEM     1 // "more_mem"    bytes
+#define MY_M_SHORT_WAIT   2 // "short_wait"  pause count
+#define MY_M_LONG_WAIT    3 // "long_wait"   nanoseconds
+#define MY_M_LARGE        4 // "large"       bytes
+#define MY_M_TRIM         5 // "trim"        bytes
+#define MY_M_CACHE        6 // "cache"       allocations
+#define MY_M_ARENAS       7 // "arenas"      heaps
+#define MY_M_GUARD_RATE   8 // "guard_rate"  calls
+#define MY_M_GUARD_SLOTS  9 // "guard_slots" pages
+#define MY_M_FIT         10 // "fit"         MY_MALLOC_FIT_*
+#define MY_M_PROFILE     11 // "profile"     0 or 1
+#define MY_M_GROW_MAX    12 // "grow_max"    bytes
+#define MY_M_RESERVE     13 // "reserve"     bytes
+#define MY_M_TRANSFER    14 // "transfer"    batches
+#define MY_M_DECAY       15 // "decay"       milliseconds
+#define MY_M_SEGREGATE   16 // "segregate"   0 or 1
+#define MY_M_COALESCE    17 // "coalesce"    frees
+#define MY_M_PUBLISH     18 // "publish"     milliseconds
+
+/*  Where in a heap an allocation is placed.
+
+    FIRST   lowest block that fits, then the largest
+            free space in it
+    BEST    block with the least room that fits, then
+            the smallest free space in it that fits
+    NEXT    lowest fit, starting from the block of the
+            last allocation in the heap
+    LIFO    space the calling thread freed last if it
+            fits, otherwise lowest fit
+    LOWEST  lowest block, then lowest free space in
+            it, that fits
+*/
+#define MY_MALLOC_FIT_FIRST  0
+#define MY_MALLOC_FIT_BEST   1
+#define MY_MALLOC_FIT_NEXT   2
+#define MY_MALLOC_FIT_LIFO   3
+#define MY_MALLOC_FIT_LOWEST 4
+
+/*  Alignment of every allocation, that of max_align_t
+    on 64 bit systems. Only more needs
+    my_aligned_alloc.
+*/
+#define MY_MALLOC_MIN_ALIGN (2 * sizeof(size_t))
+
 // request n bytes of contiguous memory
 void* my_malloc(size_t bytes);
 
@@ -26,4 +342,229 @@ void* my_calloc(size_t num, size_t bytes);
 
 void* my_realloc(void *ptr, size_t size);
 
+// request bytes starting at a multiple of align,
+// a power of 2 of atmost a page, freed with my_free
+// return NULL if align is not
+void* my_aligned_alloc(size_t align, size_t bytes);
+
 void* my_reallocarray(void *ptr, size_t nmemb, size_t size);
+
+// number of bytes which can be used at ptr,
+// atleast what was requested
+size_t my_malloc_usable_size(void* ptr);
+
+// number of bytes my_malloc(bytes) would give,
+// as returned by my_malloc_usable_size
+size_t my_malloc_good_size(size_t bytes);
+
+// set param to value
+// return 1 on success, 0 if param or value is invalid
+int   my_mallopt(int param, size_t value);
+
+// fill lat with the latency of kind, one of
+// MY_MALLOC_LAT_*, since the last reset
+void  my_malloc_latency(int kind, struct MallocLatency* lat);
+
+// forget every latency and size recorded so far
+void  my_malloc_latency_reset();
+
+// write how many small allocations of each size
+// were requested while profiling to fd, one
+// "size count" line per 8 bytes of sizes, each
+// size rounded up, for tools/size_classes
+void  my_malloc_size_dump(int fd);
+
+/*  Flags for my_malloc_reserve.
+
+    POPULATE    fault every page in up front
+    LOCK        keep every page in memory, see mlock
+*/
+#define MY_MALLOC_RESERVE_POPULATE 1
+#define MY_MALLOC_RESERVE_LOCK     2
+
+// map atleast bytes for the calling thread's heap
+// ahead of time, so allocations of less than
+// large_sz bytes need no mmap until it is used up
+// return 1 on success, 0 otherwise
+int   my_malloc_reserve(size_t bytes, int flags);
+
+/*  Heap of its own, seperate from the one used
+    by my_malloc. Made with my_heap_create.
+*/
+struct MallocHeap;
+
+// create an empty heap
+// return NULL on failure
+struct MallocHeap* my_heap_create();
+
+// same as my_malloc, my_free and my_realloc but
+// on heap
+void* my_heap_malloc(struct MallocHeap* heap, size_t bytes);
+void  my_heap_free(struct MallocHeap* heap, void* ptr);
+void* my_heap_realloc(struct MallocHeap* heap, void* ptr, size_t size);
+void* my_heap_aligned_alloc(struct MallocHeap* heap, size_t align, size_t bytes);
+
+// same as my_malloc_reserve but for heap
+int   my_heap_reserve(struct MallocHeap* heap, size_t bytes, int flags);
+
+// release heap and every allocation on it
+void  my_heap_destroy(struct MallocHeap* heap);
+
+// fill stats for heap, or for all heaps used
+// by my_malloc if heap is NULL
+void  my_heap_stats(struct MallocHeap* heap, struct MallocStats* stats);
+
+/*  Contention on one block.
+*/
+struct MallocHotBlock
+{
+    void*  block;
+    size_t sz;
+    size_t fails;
+    size_t spins;
+};
+
+// fill hot with the atmost num blocks of heap, or of
+// every heap used by my_malloc if heap is NULL, which
+// were contended the most, most contended first
+// return the number filled
+size_t my_heap_hot_blocks(struct MallocHeap* heap, struct MallocHotBlock* hot, size_t num);
+
+/*  One thing seen by my_heap_walk.
+
+    MAPPING     addr and sz are the whole mapping
+    BLOCK       addr and sz are the whole block,
+                including its meta data
+    ALLOC       addr is what my_malloc returns or
+                would, sz is its usable size
+*/
+#define MY_MALLOC_WALK_MAPPING 0
+#define MY_MALLOC_WALK_BLOCK   1
+#define MY_MALLOC_WALK_ALLOC   2
+
+struct MallocWalkEntry
+{
+    int    kind;
+    void*  addr;
+    size_t sz;
+
+    /*  Whether an allocation is handed out. Those in
+        a thread cache count as handed out.
+    */
+    int    in_use;
+};
+
+// called by my_heap_walk for every entry, must
+// not allocate or free from the heap walked
+// return non 0 to stop the walk
+typedef int (*my_malloc_walk_fn)(const struct MallocWalkEntry* entry, void* ctx);
+
+// call fn with ctx on every mapping of heap, or of
+// every heap used by my_malloc if heap is NULL, then
+// on every block in it, each followed by every
+// allocation in it, in address order
+// return 0 if walked to the end, otherwise what
+// fn returned to stop
+int   my_heap_walk(struct MallocHeap* heap, my_malloc_walk_fn fn, void* ctx);
+
+// write a line per block of heap, or every heap used
+// by my_malloc if heap is NULL, to fd with its used
+// and free bytes, largest hole and how much of its
+// free bytes are outside of that hole, then the same
+// over all blocks and a histogram of hole sizes
+void  my_heap_dump(struct MallocHeap* heap, int fd);
+
+// find the heap ptr was allocated from, constant
+// time if a reserve is set, otherwise only heaps
+// used by my_malloc and heap are searched
+// return the heap, or NULL if not found
+struct MallocHeap* my_heap_of(struct MallocHeap* heap, void* ptr);
+
+/*  Pool of fixed size objects. Made with
+    my_pool_create.
+*/
+struct MallocPool;
+
+// create a pool of objects of obj_size bytes each
+// aligned to align, a power of 2 of atmost a page
+// return NULL on failure
+struct MallocPool* my_pool_create(size_t obj_size, size_t align);
+
+// get one object from pool
+void* my_pool_alloc(struct MallocPool* pool);
+
+// give ptr back to the pool it came from
+void  my_pool_free(struct MallocPool* pool, void* ptr);
+
+// release pool and every object in it
+void  my_pool_destroy(struct MallocPool* pool);
+
+/*  Region of scratch memory. Made with
+    my_region_create. A region must only be used
+    by one thread at a time.
+*/
+struct MallocRegion;
+
+// create an empty region
+// return NULL on failure
+struct MallocRegion* my_region_create();
+
+// get bytes from region, which are only given
+// back by a reset or destroy
+void* my_region_alloc(struct MallocRegion* region, size_t bytes);
+
+// give back every allocation from region, keeping
+// its memory for later allocations
+void  my_region_reset(struct MallocRegion* region);
+
+// release region and every allocation from it
+void  my_region_destroy(struct MallocRegion* region);
+
+// allocate from size class cls when the thread
+// cache for it is empty
+void* my_malloc_class(size_t cls);
+
+// size class which holds bytes
+// MY_MALLOC_NUM_CLASSES if bytes is not small
+__attribute__((always_inline))
+static inline size_t my_malloc_size_class(size_t bytes)
+{
+    #define MY_MALLOC_CLASS_CMP(INDEX, SZ) \
+        bytes <= (SZ) ? (INDEX) :
+
+    return MY_MALLOC_SIZE_CLASSES(MY_MALLOC_CLASS_CMP) MY_MALLOC_NUM_CLASSES;
+
+    #undef MY_MALLOC_CLASS_CMP
+}
+
+// same as my_malloc, but when bytes is a compile
+// time constant the size class is resolved at
+// compile time and only a free list pop is done
+__attribute__((always_inline))
+static inline void* my_malloc_inline(size_t bytes)
+{
+    if (__builtin_constant_p(bytes) && bytes <= MY_MALLOC_SMALL_MAX)
+    {
+        const size_t cls = my_malloc_size_class(bytes);
+        void* res = my_malloc_tcache.head[cls];
+
+        if (__builtin_expect(res != NULL, 1))
+        {
+            my_malloc_tcache.head[cls] = *(void**)res;
+            if (--my_malloc_tcache.count[cls] < my_malloc_tcache.low[cls])
+            {
+                my_malloc_tcache.low[cls] = my_malloc_tcache.count[cls];
+            }
+
+            return res;
+        }
+
+        return my_malloc_class(cls);
+    }
+
+    return my_malloc(bytes);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,376 @@
+#pragma once
+#include <custom_mem/malloc.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+
+/*  C++ over custom_mem/malloc.h.
+
+    malloc_resource, heap_resource and region_resource
+    are std::pmr::memory_resource's over my_malloc, a
+    heap and a region. allocator is a stateless STL
+    allocator over my_malloc.
+
+    Defining MY_MALLOC_REPLACE_NEW in exactly one
+    translation unit before including this header
+    replaces the global operator new and delete with
+    my_malloc and my_free.
+
+    my_malloc aligns to MY_MALLOC_MIN_ALIGN, atleast
+    __STDCPP_DEFAULT_NEW_ALIGNMENT__ on 64 bit systems,
+    so only over-aligned types go through
+    my_aligned_alloc, which is slower.
+*/
+
+namespace custom_mem
+{
+
+namespace detail
+{
+
+// allocate bytes aligned to align
+// return nullptr on failure
+inline void* alloc(std::size_t bytes, std::size_t align) noexcept
+{
+    // no object smaller than its alignment exists, so
+    // small requests never need more than my_malloc
+
+    if (align <= MY_MALLOC_MIN_ALIGN || bytes < align)
+    {
+        return my_malloc(bytes);
+    }
+
+    return my_aligned_alloc(align, bytes);
+}
+
+// same as alloc but throws std::bad_alloc
+inline void* alloc_or_throw(std::size_t bytes, std::size_t align)
+{
+    void* res = alloc(bytes, align);
+    if (!res)
+    {
+        throw std::bad_alloc();
+    }
+
+    return res;
+}
+
+}
+
+// memory_resource over my_malloc
+class malloc_resource : public std::pmr::memory_resource
+{
+private:
+    void* do_allocate(std::size_t bytes, std::size_t align) override
+    {
+        return detail::alloc_or_throw(bytes, align);
+    }
+
+    void  do_deallocate(void* ptr, std::size_t, std::size_t) override
+    {
+        my_free(ptr);
+    }
+
+    bool  do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return dynamic_cast<const malloc_resource*>(&other) != nullptr;
+    }
+};
+
+// malloc_resource shared by everything
+inline malloc_resource* get_malloc_resource() noexcept
+{
+    static malloc_resource resource;
+
+    return &resource;
+}
+
+// memory_resource over a heap, which it does not own
+class heap_resource : public std::pmr::memory_resource
+{
+public:
+    explicit heap_resource(struct MallocHeap* heap) noexcept :
+        heap_(heap)
+    {}
+
+    struct MallocHeap* heap() const noexcept
+    {
+        return heap_;
+    }
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t align) override
+    {
+        void* res = align <= MY_MALLOC_MIN_ALIGN ?
+            my_heap_malloc(heap_, bytes) :
+            my_heap_aligned_alloc(heap_, align, bytes);
+
+        if (!res)
+        {
+            throw std::bad_alloc();
+        }
+
+        return res;
+    }
+
+    void  do_deallocate(void* ptr, std::size_t, std::size_t) override
+    {
+        my_heap_free(heap_, ptr);
+    }
+
+    bool  do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        const heap_resource* other_heap = dynamic_cast<const heap_resource*>(&other);
+
+        return other_heap && other_heap->heap_ == heap_;
+    }
+
+    struct MallocHeap* heap_;
+};
+
+// memory_resource over a region, which it does not
+// own, deallocating does nothing
+class region_resource : public std::pmr::memory_resource
+{
+public:
+    explicit region_resource(struct MallocRegion* region) noexcept :
+        region_(region)
+    {}
+
+    struct MallocRegion* region() const noexcept
+    {
+        return region_;
+    }
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t align) override
+    {
+        // regions align to max_align_t, room is left
+        // to align further
+
+        std::size_t extra = align > alignof(std::max_align_t) ? align : 0;
+        if (bytes + extra < bytes)
+        {
+            throw std::bad_alloc();
+        }
+
+        void* res = my_region_alloc(region_, bytes + extra);
+        if (!res)
+        {
+            throw std::bad_alloc();
+        }
+
+        std::uintptr_t at = reinterpret_cast<std::uintptr_t>(res);
+
+        return reinterpret_cast<void*>(extra ? (at + align - 1) & ~(align - 1) : at);
+    }
+
+    void  do_deallocate(void*, std::size_t, std::size_t) override
+    {}
+
+    bool  do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        const region_resource* other_region = dynamic_cast<const region_resource*>(&other);
+
+        return other_region && other_region->region_ == region_;
+    }
+
+    struct MallocRegion* region_;
+};
+
+// stateless STL allocator over my_malloc
+template<class T>
+struct allocator
+{
+    using value_type = T;
+
+    allocator() noexcept = default;
+
+    template<class U>
+    allocator(const allocator<U>&) noexcept
+    {}
+
+    T*   allocate(std::size_t num)
+    {
+        if (num > SIZE_MAX / sizeof(T))
+        {
+            throw std::bad_array_new_length();
+        }
+
+        return static_cast<T*>(detail::alloc_or_throw(num * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* ptr, std::size_t) noexcept
+    {
+        my_free(ptr);
+    }
+};
+
+template<class T, class U>
+bool operator==(const allocator<T>&, const allocator<U>&) noexcept
+{
+    return true;
+}
+
+template<class T, class U>
+bool operator!=(const allocator<T>&, const allocator<U>&) noexcept
+{
+    return false;
+}
+
+}
+
+#ifdef MY_MALLOC_REPLACE_NEW
+
+/*  Replacements can not be inline, so are only
+    defined where asked for. The size and alignment
+    given to delete are not needed, my_free reads
+    both from the allocation meta data and pushes
+    class sized allocations onto the thread cache.
+*/
+
+namespace custom_mem
+{
+
+namespace detail
+{
+
+// allocate like operator new, calling the new
+// handler until it succeeds or there is none
+inline void* new_alloc(std::size_t bytes, std::size_t align)
+{
+    for (;;)
+    {
+        void* res = alloc(bytes ? bytes : 1, align);
+        if (res)
+        {
+            return res;
+        }
+
+        std::new_handler handler = std::get_new_handler();
+        if (!handler)
+        {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+inline void* new_alloc_nothrow(std::size_t bytes, std::size_t align) noexcept
+{
+    try
+    {
+        return new_alloc(bytes, align);
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+}
+
+}
+
+void* operator new(std::size_t bytes)
+{
+    return custom_mem::detail::new_alloc(bytes, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void* operator new[](std::size_t bytes)
+{
+    return custom_mem::detail::new_alloc(bytes, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void* operator new(std::size_t bytes, const std::nothrow_t&) noexcept
+{
+    return custom_mem::detail::new_alloc_nothrow(bytes, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void* operator new[](std::size_t bytes, const std::nothrow_t&) noexcept
+{
+    return custom_mem::detail::new_alloc_nothrow(bytes, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void* operator new(std::size_t bytes, std::align_val_t align)
+{
+    return custom_mem::detail::new_alloc(bytes, static_cast<std::size_t>(align));
+}
+
+void* operator new[](std::size_t bytes, std::align_val_t align)
+{
+    return custom_mem::detail::new_alloc(bytes, static_cast<std::size_t>(align));
+}
+
+void* operator new(std::size_t bytes, std::align_val_t align, const std::nothrow_t&) noexcept
+{
+    return custom_mem::detail::new_alloc_nothrow(bytes, static_cast<std::size_t>(align));
+}
+
+void* operator new[](std::size_t bytes, std::align_val_t align, const std::nothrow_t&) noexcept
+{
+    return custom_mem::detail::new_alloc_nothrow(bytes, static_cast<std::size_t>(align));
+}
+
+void  operator delete(void* ptr) noexcept
+{
+    my_free(ptr);
+}
+
+void  operator delete[](void* ptr) noexcept
+{
+    my_free(ptr);
+}
+
+void  operator delete(void* ptr, std::size_t) noexcept
+{
+    my_free(ptr);
+}
+
+void  operator delete[](void* ptr, std::size_t) noexcept
+{
+    my_free(ptr);
+}
+
+void  operator delete(void* ptr, std::align_val_t) noexcept
+{
+    my_free(ptr);
+}
+
+void  operator delete[](void* ptr, std::align_val_t) noexcept
+{
+    my_free(ptr);
+}
+
+void  operator delete(void* ptr, std::size_t, std::align_val_t) noexcept
+{
+    my_free(ptr);
+}
+
+void  operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept
+{
+    my_free(ptr);
+}
+
+void  operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+    my_free(ptr);
+}
+
+void  operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+    my_free(ptr);
+}
+
+void  operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    my_free(ptr);
+}
+
+void  operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+    my_free(ptr);
+}
+
+#endif
@@ -0,0 +1,46 @@
+#pragma once
+
+#ifdef MY_MALLOC_SIZE_CLASSES_HEADER
+
+/*  Classes made by tools/size_classes, see
+    SIZE_CLASSES in the top Makefile.
+*/
+#include MY_MALLOC_SIZE_CLASSES_HEADER
+
+#else
+
+/*  Size classes for small allocations.
+
+    Every small allocation is rounded up to the
+    smallest class which holds it. Each entry is
+    X(index, bytes). Classes must be increasing
+    multiples of MY_MALLOC_MIN_ALIGN, and the last
+    class is the largest small allocation.
+*/
+#define MY_MALLOC_SIZE_CLASSES(X) \
+    X(0,  16)   \
+    X(1,  32)   \
+    X(2,  48)   \
+    X(3,  64)   \
+    X(4,  80)   \
+    X(5,  96)   \
+    X(6,  112)  \
+    X(7,  128)  \
+    X(8,  160)  \
+    X(9,  192)  \
+    X(10, 224)  \
+    X(11, 256)  \
+    X(12, 320)  \
+    X(13, 384)  \
+    X(14, 448)  \
+    X(15, 512)  \
+    X(16, 640)  \
+    X(17, 768)  \
+    X(18, 896)  \
+    X(19, 1024)
+
+#define MY_MALLOC_NUM_CLASSES 20
+
+#define MY_MALLOC_SMALL_MAX 1024
+
+#endif
@@ -16,6 +16,8 @@
         Every allocation has MY_MALLOC_ALLOC_META bytes
         of overhead. Usually 8 and 16 bytes for 32 and
         64 bit systems respectively.
+        Blocks besides large ones have an index of two
+        bits per MY_MALLOC_ALIGN bytes, under 2%.
 
     Locking:
 
@@ -25,7 +27,7 @@
         
         (1)
         A lock on (1) gives a thread exclusive access
-        to that entire linked list level.
+        to that entire linked list level of a heap.
             ie no other mapping can be modified
         Locking this level is used for when the linked
         list of mappings needs to be modified. This only
@@ -47,7 +49,8 @@
 
         An allocation causes a searching all three levels
         of linked lists.
-        A first fit strategy is used for allocations.
+        The block and the space in it are picked by the
+        G_vars.fit policy, first fit by default.
         Once a space is found in a block, the space
         gets set to taken and the entire block is iterated
         over to update meta data.
@@ -55,7 +58,156 @@
     Free:
 
         A free causes a looping over of the block the
-        memory was requested from.
+        memory was requested from. If another thread
+        holds the block, the allocation is pushed onto
+        the block's thread free list instead, without
+        waiting. Whichever thread locks the block next
+        frees everything on the list first.
+
+    Heaps:
+
+        The three layers of linked lists hang off of a
+        heap. Every heap has its own mappings and its
+        own lock for (1) below. my_malloc uses one of
+        G_vars.arenas heaps per thread, other heaps are
+        made with my_heap_create.
+
+    Thread Cache:
+
+        Small allocations are rounded up to a size class
+        (see custom_mem/size_classes.h). A free of an
+        allocation whose size is exactly a class size
+        pushes it onto the freeing thread's list for that
+        class instead of touching the block. The
+        allocation stays in use as far as the block is
+        concerned. A small allocation pops from the list
+        before searching any block.
+
+        A thread whose list is full moves half of it as
+        one batch to the transfer cache of that class,
+        and a thread whose list is empty takes a whole
+        batch from there before going to the blocks. So
+        allocations freed on one thread reach another in
+        one locked step each way, never touching a block.
+
+        The lists are given back to the transfer cache,
+        then to the blocks, when the thread exits.
+
+    Segregation:
+
+        With G_vars.segregate set, a thread puts its small
+        allocations only in blocks of its arena it owns,
+        claiming one no thread owns or making a new one
+        when those are full. Small allocations freed by
+        another thread go back to the block instead of
+        that thread's cache. So objects of two threads
+        never share a cache line. The thread cache then
+        holds only objects of the thread's own blocks,
+        and skips the transfer cache both ways, giving
+        what it can not hold back to the blocks. A
+        thread gives up its blocks when it exits. Off
+        by default, as it trades memory for it.
+
+        Blocks start on a cache line, and keep is_free
+        and the counters every thread writes on a second
+        line, away from what searching threads read.
+
+    Coalescing:
+
+        With G_vars.coalesce set, a free only marks its
+        node free and counts it on the block, leaving it
+        apart from free nodes next to it. The block merges
+        them all once that many frees are pending, when
+        it is next allocated from, or when an allocation
+        finds no block with room, before the heap grows.
+
+    Pools:
+
+        A pool hands out objects of one size from runs of
+        memory it gets with _mem_get. The pool meta data
+        sits at the start of its first run, and every run
+        starts with a pointer to the next run. Objects have
+        no meta data. Free objects are linked through their
+        first bytes.
+
+    Regions:
+
+        A region bump allocates from runs it gets with
+        _mem_get, the first of which holds the region.
+        Nothing is freed on its own. A reset rewinds to
+        the first run and keeps every run for reuse.
+        Allocations of atleast G_vars.large_sz bytes go
+        to my_malloc, linked through a pointer in front
+        of them, and are freed on reset.
+
+    Guard:
+
+        One in G_vars.guard_rate calls to my_malloc is
+        sampled and served from a guard slot instead, a
+        page between two inaccessible pages. The allocation
+        is sized like a node and put against the end of the
+        page, so overflows are caught once past the node,
+        keeping it aligned like any other. Freeing it makes
+        the page inaccessible too. A SIGSEGV handler reports
+        accesses to the guard pages as overflows and
+        underflows, and to freed slots as use after free,
+        then lets the fault happen again with the handler
+        from before.
+
+    Decay:
+
+        With G_vars.decay_ms set, a background thread
+        wakes every half of it. Blocks of the heaps used
+        by my_malloc which have not been allocated from
+        or freed in for decay_ms have the pages of their
+        free space given back, and batches idle as long
+        in the transfer cache are freed to their blocks.
+        Blocks taken at the time are skipped until the
+        next wake up. Mappings are never unmapped, as
+        threads walk them without holding the heap, but
+        an empty one keeps only its meta data pages.
+
+        Thread caches are only touched by their thread,
+        so each trims its own. On a free or a cache miss
+        once decay_ms passed since it last did, a thread
+        frees to their blocks as many allocations of
+        each class as were never taken from its cache
+        in that time, the fewest it held. A thread which
+        stopped calling keeps its cache until it exits.
+
+    Publish:
+
+        With G_vars.publish_ms set, a background thread
+        makes a shared memory segment named after the
+        pid and writes the statistics of the heaps used
+        by my_malloc to it every publish_ms, under a
+        seqlock so readers in other processes never wait
+        on it or see half of a write. They are read from
+        counters kept as memory is mapped and allocations
+        are made, so no block or heap is ever taken.
+        The segment is removed when the process exits.
+        A child made by fork publishes again only once
+        it sets publish_ms itself.
+
+    Large:
+
+        Allocations of atleast G_vars.large_sz bytes
+        skip the search and get a mapping holding a
+        single block to themselves. Freeing one unmaps
+        the whole mapping.
+
+    Reserve:
+
+        With G_vars.reserve_sz set, one range of that
+        many bytes is reserved inaccessible the first
+        time a heap maps, and every mapping of every
+        heap is taken from it and made accessible. A
+        table with an entry per page of the range points
+        at the mapping the page is in, so the mapping of
+        any pointer is found by a shift and an index.
+        Unmapping gives the pages back to the os and the
+        extent to the range. Once the range is full,
+        mappings are mapped on their own again.
 
     Constraints:
 
@@ -76,6 +228,11 @@
 
         - Assume mmap is zero backed. This is very likely to
           be true, but not gaurenteed.
+
+          Every block remembers past which byte it has
+          never been written (_block.clean). my_calloc only
+          zeroes the part of an allocation before that, and
+          never zeroes large allocations.
 */
 
 #include <custom_mem/malloc.h>
@@ -84,17 +241,68 @@
 #include <sys/mman.h> // mmap
 #include <stdint.h>   // SIZE_MAX
 #include <string.h>   // memset, memcpy
+#include <stdlib.h>   // getenv, strtoull
+#include <unistd.h>   // sysconf
+#include <pthread.h>  // pthread_key_create
+#include <signal.h>   // sigaction
+#include <time.h>     // clock_gettime
+#include <stdio.h>    // dprintf
+#include <fcntl.h>    // O_CREAT
+
+/*  Bytes in a cache line. Mappings and blocks
+    start on one.
+*/
+#define MY_MALLOC_LINE 64
 
-typedef struct MallocGlobal
+/*  A heap owns every mapping made for it. The
+    allocations of one heap never share a block
+    or mapping with another heap.
+*/
+typedef struct MallocHeap
 {
     struct MallocMapping* start_map;
 
+    /*  Last mapping, where blocks are appended.
+    */
+    struct MallocMapping* end_map;
+
+    /*  Mappings holding one large allocation each.
+    */
+    struct MallocMapping* large_map;
+
     /*  Whether any mapping is currently
         being modified.
     */
     atomic_char is_free;
+
+    /*  Only modified with is_free held, read
+        without it by the publish thread.
+    */
+    atomic_size_t mapped;
+    atomic_size_t num_mmap;
+    atomic_size_t num_munmap;
+
+    /*  Bytes of the allocations in large_map, kept
+        the same way.
+    */
+    atomic_size_t large;
+
+    /*  Block of the last allocation and its mapping,
+        where next fit starts looking. Written without
+        holding anything, so may not match.
+    */
+    void* rover;
+    struct MallocMapping* rover_map;
+
+    /*  Times is_free was found taken.
+    */
+    atomic_size_t fails;
+
+    /*  Bytes given back by the decay thread.
+    */
+    atomic_size_t purged;
 }
-_global;
+_heap;
 
 /*  Is the top level in linked list chain.
     Mapping's cannot be locked. They consist
@@ -105,25 +313,46 @@ _global;
 */
 typedef struct MallocMapping
 {
-    /* Starting block in this mapping.
-    */
-    void* start_block;
-
-    /* Ending block in this mapping.
-    */
-    void* end_block;
-
-    /* Next mapping.
-    */
-    struct MallocMapping* next;
-
-    /* Start of this mapping.
-    */
-    void* start;
-
-    /* End of this mapping.
+    /*  Padded to a line so the first block starts
+        on one.
     */
-    void* end;
+    union
+    {
+        struct
+        {
+            /* Starting block in this mapping. NULL
+               until a reserved mapping is first used.
+            */
+            void* start_block;
+
+            /* Ending block in this mapping.
+            */
+            void* end_block;
+
+            /* Next mapping.
+            */
+            struct MallocMapping* next;
+
+            /* Previous mapping. Only kept for large
+               mappings.
+            */
+            struct MallocMapping* prev;
+
+            /* Heap this mapping belongs to.
+            */
+            struct MallocHeap* heap;
+
+            /* Start of this mapping.
+            */
+            void* start;
+
+            /* End of this mapping.
+            */
+            void* end;
+        };
+
+        char line[MY_MALLOC_LINE];
+    };
 }
 _mapping;
 
@@ -140,6 +369,7 @@ _mapping;
     the block.
         ie
         BLOCK_META_DATA         |
+        INDEX                   |
         META_DATA (sz_1,used)   |
         ...                     |
             in use memory       |
@@ -169,37 +399,355 @@ _mapping;
 
         Where sz_N represents the amount of bytes that can be
         allocated in a particular node.
+
+    The index holds two bitmaps with a bit per
+    MY_MALLOC_ALIGN bytes of nodes. The first has the
+    bits of where nodes start set, the second those of
+    nodes in use. Searches and merges only read the
+    index, never the nodes themselves. Large blocks
+    have no index.
 */
 typedef struct MallocBlock
 {
-    /*  Maximum contiguous number of free contiguous bytes.
+    /*  Read by every searching thread, written only by
+        whoever holds the block.
+    */
+    union
+    {
+        struct
+        {
+            /*  Maximum contiguous number of free contiguous bytes.
+            */
+            size_t max_free;
+
+            /*  Size in bytes this block takes in its entirety.
+            */
+            size_t sz;
+
+            /*  Next block.
+
+                The next block will be directly after the
+                current block in memory.
+                If no next block, then NULL.
+            */
+            void* next;
+
+            /*  Pointer to metadata of where max free space is.
+            */
+            void* max_free_ptr;
+
+            /*  Token of the thread whose small allocations
+                go here, NULL if none. See _block_get_home.
+            */
+            _Atomic(void*) owner;
+
+            /*  MY_MALLOC_BLOCK_* flags.
+            */
+            char flags;
+
+            /*  Offset of the first byte after which nothing in
+                the block has ever been written, so is still
+                zero from mmap. Saturates at UINT32_MAX, after
+                which the whole block counts as written.
+            */
+            uint32_t clean;
+
+            /*  G_decay_now when last allocated from or
+                freed in.
+            */
+            uint32_t touched;
+
+            /*  Words in each bitmap of the index, 0 if
+                the block has none.
+            */
+            uint32_t words;
+
+            /*  Frees whose nodes are not merged with their
+                neighbours yet, see _block_merge_later.
+            */
+            uint32_t pending;
+        };
+
+        char line_0[MY_MALLOC_LINE];
+    };
+
+    /*  Written by every thread trying for the block,
+        so kept off of the line above.
+    */
+    union
+    {
+        struct
+        {
+            /*  Whether being modified currently.
+            */
+            atomic_char is_free;
+
+            /*  Times is_free was found taken by _block_acquire,
+                and times _block_lock waited on it.
+            */
+            atomic_uint fails;
+            atomic_uint spins;
+
+            /*  Times a free went onto thread_free.
+            */
+            atomic_uint deferred;
+
+            /*  Allocations freed while the block was held,
+                linked through their first bytes. Still in use
+                as far as the block is concerned.
+            */
+            _Atomic(void*) thread_free;
+
+            /*  Bytes and number of allocations in use. Only
+                written by whoever holds the block, read
+                without it by the publish thread.
+            */
+            atomic_size_t used;
+            atomic_uint   used_nodes;
+        };
+
+        char line_1[MY_MALLOC_LINE];
+    };
+}
+_block;
+
+/*  Fixed size object pool.
+*/
+typedef struct MallocPool
+{
+    /*  Bytes per object, rounded up to align.
+    */
+    size_t obj_sz;
+
+    /*  Where the first object in a run goes.
+    */
+    size_t obj_offset;
+
+    /*  Most recently freed object.
+    */
+    void* free_list;
+
+    /*  Next never used object in the newest run.
+    */
+    char* bump;
+
+    /*  End of the newest run.
+    */
+    char* bump_end;
+
+    /*  Newest run. The pool itself is in the
+        oldest one.
+    */
+    void* runs;
+
+    /*  Whether being modified currently.
+    */
+    atomic_char is_free;
+}
+_pool;
+
+/*  Bump allocated scratch memory.
+*/
+typedef struct MallocRegion
+{
+    /*  Next free byte in the current run.
+    */
+    char* bump;
+
+    /*  End of the current run.
     */
-    size_t max_free;
+    char* bump_end;
 
-    /*  Size in bytes this block takes in its entirety.
+    /*  Run being bumped through.
     */
+    struct MallocRun* curr;
+
+    /*  Oldest run. Holds the region itself.
+    */
+    struct MallocRun* first;
+
+    /*  Allocations too large for a run, which
+        came from my_malloc.
+    */
+    void* large;
+}
+_region;
+
+/*  Every pool and region run starts with this.
+*/
+typedef struct MallocRun
+{
+    struct MallocRun* next;
     size_t sz;
+}
+_run;
+
+/*  One guard slot.
+*/
+struct MallocGuardSlot
+{
+    /*  Bytes requested, and bytes taken at the
+        end of the slot.
+    */
+    size_t bytes;
+    size_t sz;
+
+    /*  MY_MALLOC_GUARD_* state.
+    */
+    char state;
+};
+
+/*  Sampled allocations, each alone on a page
+    between two inaccessible pages.
+*/
+typedef struct MallocGuard
+{
+    /*  First guard page. Set once, when the first
+        allocation is sampled.
+    */
+    char* start;
+
+    /*  Bytes from start to the end of the last guard
+        page. 0 until everything else is set.
+    */
+    atomic_size_t len;
+
+    size_t page;
+
+    size_t slots;
+
+    /*  Where to start looking for a free slot.
+    */
+    size_t next;
+
+    struct MallocGuardSlot* slot;
 
     /*  Whether being modified currently.
     */
     atomic_char is_free;
+}
+_guard;
+
+/*  Extent given back to the range, its first page
+    is kept accessible to hold this.
+*/
+typedef struct MallocRangeFree
+{
+    struct MallocRangeFree* next;
 
-    /*  Next block.
+    size_t sz;
+}
+_range_free;
+
+/*  Address space reserved up front which mappings
+    are taken from.
+*/
+typedef struct MallocRange
+{
+    /*  Set once, when the first mapping is taken.
+    */
+    char* start;
+
+    /*  Bytes from start to the end of the range. 0
+        until everything else is set.
+    */
+    atomic_size_t len;
 
-        The next block will be directly after the
-        current block in memory.
-        If no next block, then NULL.
+    /*  Bytes before this have been handed out atleast
+        once.
+    */
+    char* bump;
+
+    _range_free* free;
+
+    /*  Mapping each page is in, NULL if in none.
+    */
+    _mapping** table;
 
-        Keep this here to allow for easy future
-        changes.
+    /*  log2 of the page size.
     */
-    void* next;
+    size_t shift;
 
-    /*  Pointer to metadata of where max free space is.
+    /*  Whether being modified currently.
     */
-    void* max_free_ptr;
+    atomic_char is_free;
 }
-_block;
+_range;
+
+/*  Most batches the transfer cache can hold per
+    size class.
+*/
+#define MY_MALLOC_TRANSFER_SLOTS 64
+
+/*  Batches of allocations of one size class on
+    their way from one thread cache to another.
+*/
+typedef struct MallocTransfer
+{
+    /*  First allocation of each batch, the rest are
+        linked through their first bytes.
+    */
+    void* batch[MY_MALLOC_TRANSFER_SLOTS];
+
+    /*  Allocations in each batch.
+    */
+    size_t count[MY_MALLOC_TRANSFER_SLOTS];
+
+    size_t num;
+
+    /*  Allocations in every batch. Only written with
+        is_free held, read without it for statistics.
+    */
+    atomic_size_t total;
+
+    /*  G_decay_now when a batch was last put
+        or taken.
+    */
+    uint32_t touched;
+
+    /*  Whether being modified currently.
+    */
+    atomic_char is_free;
+}
+_transfer;
+
+/*  Latency buckets. Below 8ns every nanosecond has
+    a bucket, after that every power of 2 is split
+    in 8.
+*/
+#define MY_MALLOC_PROF_SUB 3
+
+#define MY_MALLOC_PROF_BUCKETS \
+    ((64 - MY_MALLOC_PROF_SUB + 1) << MY_MALLOC_PROF_SUB)
+
+/*  Bytes covered by each bucket of requested sizes.
+*/
+#define MY_MALLOC_PROF_SIZE_STEP 8
+
+#define MY_MALLOC_PROF_SIZES \
+    ((MY_MALLOC_SMALL_MAX + MY_MALLOC_PROF_SIZE_STEP - 1) / MY_MALLOC_PROF_SIZE_STEP)
+
+/*  Latency histograms of one thread. Never freed,
+    a thread takes over one left by a thread which
+    exited.
+*/
+typedef struct MallocProfile
+{
+    /*  Count per MY_MALLOC_LAT_* and bucket.
+    */
+    uint64_t hist[MY_MALLOC_LAT_KINDS][MY_MALLOC_PROF_BUCKETS];
+
+    /*  Count of small requests per bucket of sizes.
+    */
+    uint64_t sizes[MY_MALLOC_PROF_SIZES];
+
+    struct MallocProfile* next;
+
+    /*  Whether no thread uses it.
+    */
+    atomic_char is_free;
+}
+_profile;
 
 typedef _block* _blk;
 typedef _mapping* _map;
@@ -265,29 +813,66 @@ typedef struct MallocAdjustables _vars;
     #define MY_MALLOC_CLZ(NUM) \
         __builtin_clzl(NUM)
 
+    #define MY_MALLOC_CTZ64(NUM) \
+        __builtin_ctzll(NUM)
+
 #else
 
-    static_assert(0, "Need clz or equivalent defined.")
+    static_assert(0, "Need clz and ctz or equivalent defined.")
 
 #endif
 
+/*  Bytes of block an index word covers, and takes
+    itself. Each word covers 64 granules of
+    MY_MALLOC_ALIGN bytes in both bitmaps.
+*/
+#define MY_MALLOC_INDEX_SPAN \
+    ((64 * MY_MALLOC_ALIGN) + (2 * sizeof(uint64_t)))
+
+/*  Words in each bitmap of the index of a block
+    of SZ bytes.
+*/
+#define MY_MALLOC_INDEX_WORDS(SZ) \
+    (((SZ) - sizeof(_block) + MY_MALLOC_INDEX_SPAN - 1) / MY_MALLOC_INDEX_SPAN)
+
+/*  Bytes of the index of a block with room for
+    NODES bytes of nodes. One word more than needed,
+    as rounding the block up can make it need one.
+*/
+#define MY_MALLOC_INDEX_SZ(NODES) \
+    (2 * sizeof(uint64_t) * ((((NODES) + (64 * MY_MALLOC_ALIGN) - 1) / (64 * MY_MALLOC_ALIGN)) + 1))
+
 /*  How many bytes should the block take.
 
     This is needed because for a requested number of
     bytes, there is some extra number of bytes needed
     for meta data.
 
-    {    1    }   {     2      }   {        3         }
-    (sz | 1024) + sizeof(_block) + MY_MALLOC_ALLOC_META
+    {    1    }   {     2      }   {          3             }   {  4  }
+    (sz | 1024) + sizeof(_block) + (2 * MY_MALLOC_ALLOC_META) + index
 
     1 - padding room so that every allocation doesn't
         require a new block
     2 - block meta data
-    3 - atleast one metadata will be needed for
-        atleast one allocation
+    3 - meta data for the allocation, and for the
+        free node which always follows it
+    4 - index of the nodes of 1 and 3
+
+    rounded up to a line, so the next block starts
+    on one too.
 */
 #define MY_MALLOC_BLOCK_EXPANSION(sz) \
-    (((sz) | 1024) + sizeof(_block) + MY_MALLOC_ALLOC_META)
+    MY_MALLOC_ROUND \
+    ( \
+        ((sz) | 1024) + sizeof(_block) + (2 * MY_MALLOC_ALLOC_META) + \
+        MY_MALLOC_INDEX_SZ(((sz) | 1024) + (2 * MY_MALLOC_ALLOC_META)), \
+        MY_MALLOC_LINE \
+    )
+
+/*  First node of a block, after its index.
+*/
+#define MY_MALLOC_BLOCK_NODES(VP_BLOCK) \
+    ((char*)(VP_BLOCK) + sizeof(_block) + (2 * sizeof(uint64_t) * ((_block*)(VP_BLOCK))->words))
 
 /*  Meta data per allocation.
 
@@ -349,630 +934,4716 @@ typedef struct MallocAdjustables _vars;
 #define MY_MALLOC_NEXT(VP_META) \
     ((char*)(VP_META) + MY_MALLOC_ALLOC_META + MY_MALLOC_GET_SIZE(VP_META))
 
+/*  Block is the only block in a mapping made
+    for one large allocation.
+*/
+#define MY_MALLOC_BLOCK_LARGE 1
+
+/*  Free space of the block was given back by the
+    decay thread, and nothing changed since.
+*/
+#define MY_MALLOC_BLOCK_PURGED 2
+
+/*  Round N up to a multiple of A, a power of 2.
+*/
+#define MY_MALLOC_ROUND(N, A) \
+    (((N) + (A) - 1) & ~((size_t)(A) - 1))
+
+/*  Every allocation size is a multiple of this, which
+    keeps meta data and allocations aligned. Being the
+    size of the meta data, every node starts aligned
+    too, so size classes serve what operator new asks.
+*/
+#define MY_MALLOC_ALIGN \
+    MY_MALLOC_MIN_ALIGN
+
+/*  Bytes of the node holding N bytes. Never 0, as a
+    free left for the holder of a block is linked
+    through the first bytes of its node.
+*/
+#define MY_MALLOC_NODE_SZ(N) \
+    MY_MALLOC_ROUND((N) ? (N) : 1, MY_MALLOC_ALIGN)
+
+/*  Bytes of a large mapping which are not the
+    allocation.
+*/
+#define MY_MALLOC_LARGE_META \
+    (sizeof(_mapping) + sizeof(_block) + (2 * MY_MALLOC_ALLOC_META))
+
+/*  Fewest pages zeroed with madvise instead
+    of memset.
+*/
+#define MY_MALLOC_ZERO_PAGES 64
+
+/*  States of a guard slot.
+*/
+#define MY_MALLOC_GUARD_UNUSED 0
+#define MY_MALLOC_GUARD_INUSE  1
+#define MY_MALLOC_GUARD_FREED  2
+
 #define MY_MALLOC_LOCK_FREE 1
 
 #define MY_MALLOC_LOCK_INSUSE 0
 
-static _global G_global =
+/*  Most heaps my_malloc can spread threads over.
+*/
+#define MY_MALLOC_MAX_ARENAS 64
+
+/*  Heaps used by my_malloc. Threads are given one
+    each, round robin over the first G_vars.arenas.
+*/
+#define MY_MALLOC_HEAP_INIT \
+    { .start_map = NULL, .end_map = NULL, .large_map = NULL, .is_free = MY_MALLOC_LOCK_FREE }
+
+#define MY_MALLOC_REPEAT_8(X) \
+    X, X, X, X, X, X, X, X
+
+static _heap G_arenas[MY_MALLOC_MAX_ARENAS] =
 {
-    .start_map = NULL,
-    .is_free   = MY_MALLOC_LOCK_FREE
+    MY_MALLOC_REPEAT_8(MY_MALLOC_REPEAT_8(MY_MALLOC_HEAP_INIT))
 };
 
+static atomic_size_t G_next_arena;
+
+/*  Heap the calling thread uses for my_malloc.
+*/
+static __thread _heap* G_arena;
+
 static _vars G_vars =
 {
-    .more_mem  = 1048576,
-    .long_wait =
+    .more_mem    = 1048576,
+    .long_wait   =
     {
         0,
         2000
-    }
+    },
+    .short_wait  = 32,
+    .large_sz    = 131072,
+    .trim_sz     = 0,
+    .cache_sz    = 32,
+    .arenas      = 1,
+    .guard_rate  = 0,
+    .guard_slots = 256,
+    .fit         = MY_MALLOC_FIT_FIRST,
+    .profile     = 0,
+    .grow_max    = 67108864,
+    .reserve_sz  = 0,
+    .transfer_sz = 16,
+    .decay_ms    = 0,
+    .segregate   = 0,
+    .coalesce    = 0,
+    .publish_ms  = 0
 };
 
-static void*  _mem_get(size_t bytes)
+#define MY_MALLOC_CLASS_SZ(INDEX, SZ) SZ,
+
+/*  Bytes in each size class.
+*/
+static const size_t G_class_sz[MY_MALLOC_NUM_CLASSES] =
 {
-    // get bytes more memory
+    MY_MALLOC_SIZE_CLASSES(MY_MALLOC_CLASS_SZ)
+};
 
-    void* res = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    if (res == (void*)-1)
-    {
-        return NULL;
-    }
+#undef MY_MALLOC_CLASS_SZ
 
-    return res;
-}
+/*  A class between two multiples of MY_MALLOC_MIN_ALIGN
+    never matches the node it is rounded to, so is never
+    cached.
+*/
+#define MY_MALLOC_CLASS_ALIGNED(INDEX, SZ) \
+    static_assert((SZ) % MY_MALLOC_MIN_ALIGN == 0, "size class " #INDEX " not a multiple of MY_MALLOC_MIN_ALIGN");
 
-static size_t _mem_more_sz(size_t bytes)
-{
-    // determine number of new bytes which will be allocated
+MY_MALLOC_SIZE_CLASSES(MY_MALLOC_CLASS_ALIGNED)
 
-    // Note: function will return 1 if bytes has the highest
-    //       bit set on the platform
-    //       ie: on 32 bit if bytes >= 2^31
-    //           on 64 but if bytes >= 2^63
+#undef MY_MALLOC_CLASS_ALIGNED
 
-    if (bytes < G_vars.more_mem)
-    {
-        return G_vars.more_mem;
-    }
+__thread struct MallocThreadCache my_malloc_tcache;
 
-    // lowest power of 2 greater than bytes
-    return MY_MALLOC_SHIFTER >> (MY_MALLOC_CLZ(bytes) - 1);
-}
+/*  Whether the calling thread has its cache
+    registered to be flushed on exit.
+*/
+static __thread char G_tcache_registered;
 
-static void   _wait_short()
-{
-    // wait for a relatively shorter period of time
+/*  G_decay_now when the calling thread last
+    trimmed its cache.
+*/
+static __thread uint32_t G_tcache_trimmed;
 
-    for (int i = 0; i != 32; ++i)
-    {
-        MY_MALLOC_PAUSE();
-    }
-}
+#define MY_MALLOC_TRANSFER_INIT(INDEX, SZ) \
+    { .num = 0, .is_free = MY_MALLOC_LOCK_FREE },
 
-static void   _wait_long()
+/*  Transfer cache of each size class.
+*/
+static _transfer G_transfer[MY_MALLOC_NUM_CLASSES] =
 {
-    // wait for a relatively longer period of time
-
-    /*  technically speaking, okay if nanosleep fails
-        will just be caught later on when depth limit is exceeded
-    */
+    MY_MALLOC_SIZE_CLASSES(MY_MALLOC_TRANSFER_INIT)
+};
 
-    nanosleep(&G_vars.long_wait, NULL);
-}
+#undef MY_MALLOC_TRANSFER_INIT
 
-static void   _block_lock_free(void* block)
+static _guard G_guard =
 {
-    // make the block available for modification
-
-    ((_block*)block)->is_free = MY_MALLOC_LOCK_FREE;
-    // atomic_store(&((_block*)block)->is_free, MY_MALLOC_LOCK_FREE);
-}
+    .start   = NULL,
+    .len     = 0,
+    .is_free = MY_MALLOC_LOCK_FREE
+};
 
-static int    _block_has_room(size_t bytes, _block* block)
+static _range G_range =
 {
-    // whether block has enough room for bytes
-    // plus an allocation meta data
-    // return 1 if yes, 0 otherwise
+    .start   = NULL,
+    .len     = 0,
+    .is_free = MY_MALLOC_LOCK_FREE
+};
 
-    return block->max_free >= bytes;
-}
+/*  SIGSEGV handler from before the guard
+    slots were made.
+*/
+static struct sigaction G_guard_old;
 
-static int    _block_acquire(size_t bytes, void* block)
-{
-    // acquire sole access to a block so that the
-    // block has bytes space available
-    // return 1 if successful
+/*  Allocations since the calling thread's last
+    sampled one.
+*/
+static __thread size_t G_guard_count;
 
-    _block* block_ptr = block;
-    char expected = MY_MALLOC_LOCK_FREE;
+/*  Allocation meta data the calling thread freed
+    last and its block, for MY_MALLOC_FIT_LIFO.
+*/
+static __thread void* G_recent;
+static __thread void* G_recent_block;
 
-    if (atomic_compare_exchange_strong(&block_ptr->is_free, &expected, MY_MALLOC_LOCK_INSUSE))
-    {
-        // verify available space after obtained lock
-        if (_block_has_room(bytes, block))
-        {
-            return 1;
-        }
+/*  Block of the calling thread's arena its small
+    allocations go in first. Blocks are owned by
+    the address of G_token until the thread exits.
+*/
+static __thread _block* G_home;
+static __thread char G_token;
 
-        _block_lock_free(block);
+/*  Every profile ever made.
+*/
+static _Atomic(_profile*) G_profiles;
+
+/*  Profile of the calling thread.
+*/
+static __thread _profile* G_profile;
+
+static pthread_key_t  G_prof_key;
+static pthread_once_t G_prof_once = PTHREAD_ONCE_INIT;
+
+static pthread_key_t  G_tcache_key;
+static pthread_once_t G_tcache_once = PTHREAD_ONCE_INIT;
+
+/*  Milliseconds, as last read by the decay thread.
+*/
+static atomic_uint G_decay_now;
+
+static pthread_once_t G_decay_once = PTHREAD_ONCE_INIT;
+
+// starts the decay thread, used by _vars_set
+static void   _decay_start();
+
+/*  Shared memory segment written by the publish
+    thread, NULL until made.
+*/
+static _Atomic(struct MallocShared*) G_shared;
+
+static pthread_once_t G_publish_once = PTHREAD_ONCE_INIT;
+
+// starts the publish thread, used by _vars_set
+static void   _publish_start();
+
+// has the calling thread's caches given back on
+// exit, used by _block_home_set
+static void   _tcache_register();
+
+static int    _vars_set(int param, size_t value)
+{
+    // set the adjustable param to value
+    // return 1 if set, 0 otherwise
+
+    switch (param)
+    {
+        case MY_M_MORE_MEM:
+            // mappings and the range work in whole pages
+            if (value < (size_t)sysconf(_SC_PAGESIZE) || value % sysconf(_SC_PAGESIZE))
+            {
+                return 0;
+            }
+            G_vars.more_mem = value;
+            return 1;
+        case MY_M_SHORT_WAIT:
+            G_vars.short_wait = value;
+            return 1;
+        case MY_M_LONG_WAIT:
+            G_vars.long_wait.tv_sec  = value / 1000000000;
+            G_vars.long_wait.tv_nsec = value % 1000000000;
+            return 1;
+        case MY_M_LARGE:
+            if (!value)
+            {
+                return 0;
+            }
+            G_vars.large_sz = value;
+            return 1;
+        case MY_M_TRIM:
+            G_vars.trim_sz = value;
+            return 1;
+        case MY_M_CACHE:
+            G_vars.cache_sz = value;
+            return 1;
+        case MY_M_GUARD_RATE:
+            G_vars.guard_rate = value;
+            return 1;
+        case MY_M_GUARD_SLOTS:
+            if (!value || G_guard.start)
+            {
+                return 0;
+            }
+            G_vars.guard_slots = value;
+            return 1;
+        case MY_M_FIT:
+            if (value > MY_MALLOC_FIT_LOWEST)
+            {
+                return 0;
+            }
+            G_vars.fit = value;
+            return 1;
+        case MY_M_PROFILE:
+            G_vars.profile = !!value;
+            return 1;
+        case MY_M_GROW_MAX:
+            G_vars.grow_max = value;
+            return 1;
+        case MY_M_TRANSFER:
+            if (value > MY_MALLOC_TRANSFER_SLOTS)
+            {
+                return 0;
+            }
+            G_vars.transfer_sz = value;
+            return 1;
+        case MY_M_DECAY:
+            G_vars.decay_ms = value;
+            if (value)
+            {
+                pthread_once(&G_decay_once, _decay_start);
+            }
+            return 1;
+        case MY_M_SEGREGATE:
+            G_vars.segregate = !!value;
+            return 1;
+        case MY_M_COALESCE:
+            if (value > UINT32_MAX)
+            {
+                return 0;
+            }
+            G_vars.coalesce = value;
+            return 1;
+        case MY_M_PUBLISH:
+            G_vars.publish_ms = value;
+            if (value)
+            {
+                pthread_once(&G_publish_once, _publish_start);
+            }
+            return 1;
+        case MY_M_RESERVE:
+            if (G_range.start)
+            {
+                return 0;
+            }
+            G_vars.reserve_sz = value;
+            return 1;
+        case MY_M_ARENAS:
+            if (!value || value > MY_MALLOC_MAX_ARENAS)
+            {
+                return 0;
+            }
+            G_vars.arenas = value;
+            return 1;
     }
 
     return 0;
 }
 
-static void   _block_update_meta(void* block)
+__attribute__((constructor))
+static void   _vars_init()
 {
-    // update the block meta data to reflect
-    // information in the allocation meta data's
+    // read adjustables from MY_MALLOC_CONF
+    // unknown names and bad values are skipped
 
-    /*  Algorithm explained.
+    static const struct
+    {
+        const char* name;
+        int         param;
+    }
+    names[] =
+    {
+        { "more_mem",    MY_M_MORE_MEM    },
+        { "short_wait",  MY_M_SHORT_WAIT  },
+        { "long_wait",   MY_M_LONG_WAIT   },
+        { "large",       MY_M_LARGE       },
+        { "trim",        MY_M_TRIM        },
+        { "cache",       MY_M_CACHE       },
+        { "arenas",      MY_M_ARENAS      },
+        { "guard_rate",  MY_M_GUARD_RATE  },
+        { "guard_slots", MY_M_GUARD_SLOTS },
+        { "fit",         MY_M_FIT         },
+        { "profile",     MY_M_PROFILE     },
+        { "grow_max",    MY_M_GROW_MAX    },
+        { "reserve",     MY_M_RESERVE     },
+        { "transfer",    MY_M_TRANSFER    },
+        { "decay",       MY_M_DECAY       },
+        { "segregate",   MY_M_SEGREGATE   },
+        { "coalesce",    MY_M_COALESCE    },
+        { "publish",     MY_M_PUBLISH     }
+    };
 
-        Instead of using this representation
-            (sz_1,used) -> (sz_2,free) -> (sz_3,used) ->
-        Use the following, which only shows whether
-        a node is U(sed) or F(ree)
-            U -> F -> U ->
+    const char* conf = getenv("MY_MALLOC_CONF");
+    while (conf && *conf)
+    {
+        const char* colon = strchr(conf, ':');
+        if (!colon)
+        {
+            return;
+        }
+
+        char* end;
+        size_t value = strtoull(colon + 1, &end, 0);
+
+        for (size_t i = 0; i != sizeof(names) / sizeof(names[0]); ++i)
+        {
+            size_t len = strlen(names[i].name);
+            if (len == (size_t)(colon - conf) && !strncmp(conf, names[i].name, len))
+            {
+                if (end != colon + 1)
+                {
+                    _vars_set(names[i].param, value);
+                }
+                break;
+            }
+        }
 
+        conf = strchr(end, ',');
+        if (conf)
+        {
+            ++conf;
+        }
+    }
+}
 
+static uint64_t _prof_now()
+{
+    // nanoseconds since some fixed point
 
-        This function is called after at most one
-        manipulation has been done to a block. Either
-        a free or allocation.The point is to
-        correctly update block and allocation meta
-        data to a state such that the block is valid.
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
 
-        A valid block meets all the conditions
-            - block meta data is correct
-            - at most one free consecutive node
+    return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
 
-        To update first, loop through all nodes keeping
-        track of the largest free node. Updating meta
-        data at the end.
+static void   _prof_release(void* profile)
+{
+    // let another thread take over profile
 
-        Second condition is harder.
-            Consider the following list
-                U -> F -> U -> U ->
-            which, with a free, can be turned into
-                U -> F -> F -> U ->
+    G_profile = NULL;
+    atomic_store(&((_profile*)profile)->is_free, MY_MALLOC_LOCK_FREE);
+}
 
-            Consider as well
-                U -> F -> U -> F ->
-            which, with a free, can be turned into
-                U -> F -> F -> F ->
+static void   _prof_key_create()
+{
+    // create the key used to release profiles
+    // on thread exit
 
-            Consider
-                U -> F -> U ->
-            which, with an allocation could be
-                U -> U -> U ->
+    pthread_key_create(&G_prof_key, _prof_release);
+}
 
-            With any single manipulation, atmost three
-            consecutive frees will occur. Need to
-            merge [0,3] consecutive frees.
-    */
+static _profile* _prof_get()
+{
+    // profile of the calling thread, NULL if none
+    // could be made
 
-    _block* block_ptr = block;
+    if (G_profile)
+    {
+        return G_profile;
+    }
+
+    _profile* profile = atomic_load(&G_profiles);
+    for (; profile; profile = profile->next)
+    {
+        char expected = MY_MALLOC_LOCK_FREE;
+        if (atomic_compare_exchange_strong(&profile->is_free, &expected, MY_MALLOC_LOCK_INSUSE))
+        {
+            break;
+        }
+    }
+
+    if (!profile)
+    {
+        // not _mem_get, which is itself timed
+
+        profile = mmap(NULL, sizeof(_profile), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (profile == (void*)-1)
+        {
+            return NULL;
+        }
+
+        profile->is_free = MY_MALLOC_LOCK_INSUSE;
+        profile->next = atomic_load(&G_profiles);
+        while (!atomic_compare_exchange_weak(&G_profiles, &profile->next, profile));
+    }
+
+    pthread_once(&G_prof_once, _prof_key_create);
+    pthread_setspecific(G_prof_key, profile);
+
+    G_profile = profile;
+
+    return profile;
+}
+
+static void   _prof_add(int kind, uint64_t start)
+{
+    // record the time since start as kind
+
+    _profile* profile = _prof_get();
+    if (!profile)
+    {
+        return;
+    }
+
+    uint64_t ns = _prof_now() - start;
+    size_t bucket = ns;
+
+    if (ns >= (1 << MY_MALLOC_PROF_SUB))
+    {
+        // power of 2, then the bits right after it
+
+        size_t power = 63 - __builtin_clzll(ns);
+        size_t sub = (ns >> (power - MY_MALLOC_PROF_SUB)) & ((1 << MY_MALLOC_PROF_SUB) - 1);
+
+        bucket = ((power - MY_MALLOC_PROF_SUB + 1) << MY_MALLOC_PROF_SUB) + sub;
+    }
+
+    ++profile->hist[kind][bucket];
+}
+
+static void   _prof_size(size_t bytes)
+{
+    // record a request for bytes if small
+
+    if (bytes > MY_MALLOC_SMALL_MAX)
+    {
+        return;
+    }
+
+    _profile* profile = _prof_get();
+    if (!profile)
+    {
+        return;
+    }
+
+    ++profile->sizes[bytes ? (bytes - 1) / MY_MALLOC_PROF_SIZE_STEP : 0];
+}
+
+static size_t _prof_bucket_max(size_t bucket)
+{
+    // most nanoseconds counted in bucket
+
+    if (bucket < (1 << MY_MALLOC_PROF_SUB))
+    {
+        return bucket;
+    }
 
-    size_t i = sizeof(_block);
-    void* prev = (char*)block + sizeof(_block);
+    size_t power = (bucket >> MY_MALLOC_PROF_SUB) + MY_MALLOC_PROF_SUB - 1;
+    size_t sub = bucket & ((1 << MY_MALLOC_PROF_SUB) - 1);
 
-    while (i < block_ptr->sz && MY_MALLOC_GET_AVAILABILITY(prev))
+    return (((1 << MY_MALLOC_PROF_SUB) + sub + 1) << (power - MY_MALLOC_PROF_SUB)) - 1;
+}
+
+static void*  _mem_get(size_t bytes)
+{
+    // get bytes more memory
+
+    uint64_t start = G_vars.profile ? _prof_now() : 0;
+
+    void* res = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (start)
+    {
+        _prof_add(MY_MALLOC_LAT_MMAP, start);
+    }
+
+    if (res == (void*)-1)
     {
-        i += MY_MALLOC_GET_SIZE(prev) + MY_MALLOC_ALLOC_META;
-        prev = MY_MALLOC_NEXT(prev);
+        return NULL;
     }
 
-    if (i >= block_ptr->sz)
+    return res;
+}
+
+static size_t _mem_trim(void* start, size_t bytes)
+{
+    // give back the whole pages inside of
+    // [start, start + bytes) to the os
+    // return number of bytes given back
+
+    /*  Pages are zero filled on next touch. Only the
+        pages fully inside are given back so that
+        neighbouring meta data is never touched.
+    */
+
+    size_t page = sysconf(_SC_PAGESIZE);
+    uintptr_t first = ((uintptr_t)start + page - 1) & ~(page - 1);
+    uintptr_t last  = ((uintptr_t)start + bytes) & ~(page - 1);
+
+    if (first < last && !madvise((void*)first, last - first, MADV_DONTNEED))
     {
-        // didn't find a free node
+        return last - first;
+    }
+
+    return 0;
+}
+
+static void   _mem_zero(void* start, size_t bytes)
+{
+    // zero [start, start + bytes)
 
-        block_ptr->max_free = 0;
-        block_ptr->max_free_ptr = NULL;
+    /*  Past a point it is cheaper to have the os hand
+        back zero pages than to write every byte.
+    */
+
+    size_t page = sysconf(_SC_PAGESIZE);
+    if (bytes < MY_MALLOC_ZERO_PAGES * page)
+    {
+        memset(start, 0, bytes);
 
         return;
     }
 
-    void* max = prev, *curr = MY_MALLOC_NEXT(prev);
-    i += MY_MALLOC_GET_SIZE(prev) + MY_MALLOC_ALLOC_META;
+    uintptr_t first = ((uintptr_t)start + page - 1) & ~(page - 1);
+    uintptr_t last  = ((uintptr_t)start + bytes) & ~(page - 1);
+
+    memset(start, 0, first - (uintptr_t)start);
+    if (madvise((void*)first, last - first, MADV_DONTNEED))
+    {
+        memset((void*)first, 0, last - first);
+    }
+    memset((void*)last, 0, (uintptr_t)start + bytes - last);
+}
+
+static size_t _mem_more_sz(size_t bytes)
+{
+    // determine number of new bytes which will be allocated
+
+    // Note: function will return 1 if bytes has the highest
+    //       bit set on the platform
+    //       ie: on 32 bit if bytes >= 2^31
+    //           on 64 but if bytes >= 2^63
+
+    if (bytes < G_vars.more_mem)
+    {
+        return G_vars.more_mem;
+    }
+
+    // lowest power of 2 greater than bytes
+    return MY_MALLOC_SHIFTER >> (MY_MALLOC_CLZ(bytes) - 1);
+}
+
+static void   _wait_short()
+{
+    // wait for a relatively shorter period of time
+
+    uint64_t start = G_vars.profile ? _prof_now() : 0;
 
-    /*  If execution reaches here prev will be located at
-        the first free allocation's meta data.
-        curr (i) will be the possible node after prev.
+    for (size_t i = 0; i != G_vars.short_wait; ++i)
+    {
+        MY_MALLOC_PAUSE();
+    }
 
-        A possible state at this point is
+    if (start)
+    {
+        _prof_add(MY_MALLOC_LAT_SHORT, start);
+    }
+}
 
-        (taken,sz_1) -> (taken,sz_2) -> (free,sz_3) -> (taken/free,sz_4) -> ...
-                                        prev           curr (i)
+static void   _wait_long()
+{
+    // wait for a relatively longer period of time
 
-        i = sz_1 + sz_2 + sz_3 + (META * 3) + BLOCK_META
+    /*  technically speaking, okay if nanosleep fails
+        will just be caught later on when depth limit is exceeded
     */
 
-    while (i < block_ptr->sz)
+    uint64_t start = G_vars.profile ? _prof_now() : 0;
+
+    nanosleep(&G_vars.long_wait, NULL);
+
+    if (start)
     {
-        size_t curr_sz = MY_MALLOC_GET_SIZE(curr);
+        _prof_add(MY_MALLOC_LAT_LONG, start);
+    }
+}
 
-        // merge previous and curr if both free
-        if
-        (
-            prev
-            &&
-            !MY_MALLOC_GET_AVAILABILITY(prev)
-            &&
-            !MY_MALLOC_GET_AVAILABILITY(curr)
-        )
-        {
-            // prev and curr are both free, merge
+static void   _range_lock()
+{
+    // wait for sole access to the range
+
+    char expected = MY_MALLOC_LOCK_FREE;
+    while (!atomic_compare_exchange_strong(&G_range.is_free, &expected, MY_MALLOC_LOCK_INSUSE))
+    {
+        expected = MY_MALLOC_LOCK_FREE;
+        _wait_short();
+    }
+}
 
-            size_t old_curr_sz = curr_sz;
+static int    _range_owns(void* ptr)
+{
+    // whether ptr is in the range
 
-            curr_sz += MY_MALLOC_GET_SIZE(prev) + MY_MALLOC_ALLOC_META;
+    return (uintptr_t)ptr - (uintptr_t)G_range.start < atomic_load_explicit(&G_range.len, memory_order_acquire);
+}
 
-            void* next = MY_MALLOC_NEXT(curr);
-            if
-            (
-                i + MY_MALLOC_GET_SIZE(curr) + MY_MALLOC_ALLOC_META < block_ptr->sz
-                &&
-                !MY_MALLOC_GET_AVAILABILITY(next)
-            )
-            {
-                // next is also free, merge all three
+static _map   _range_mapping(void* ptr)
+{
+    // mapping the page of ptr is in
+    // return mapping, or null if in none
+
+    // Assume: ptr is in the range
+
+    return G_range.table[((char*)ptr - G_range.start) >> G_range.shift];
+}
+
+static void   _range_set(void* start, size_t bytes, _mapping* mapping)
+{
+    // point the table at mapping for every page
+    // in [start, start + bytes)
+
+    size_t first = ((char*)start - G_range.start) >> G_range.shift;
+    size_t last  = first + (bytes >> G_range.shift);
+
+    for (size_t i = first; i != last; ++i)
+    {
+        G_range.table[i] = mapping;
+    }
+}
+
+static int    _range_init()
+{
+    // reserve the range and its table
+    // return 1 if successful
+
+    // Assume: range is held
+
+    if (G_range.start)
+    {
+        return 1;
+    }
+
+    /*  Neither the range nor the table count against
+        the memory committed until written to.
+    */
+
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t len = MY_MALLOC_ROUND(G_vars.reserve_sz, page);
+    size_t table_sz = MY_MALLOC_ROUND((len / page) * sizeof(_mapping*), page);
+
+    char* start = mmap(NULL, len, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (start == (void*)-1)
+    {
+        return 0;
+    }
+
+    _mapping** table = mmap(NULL, table_sz, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (table == (void*)-1)
+    {
+        munmap(start, len);
+        return 0;
+    }
+
+    G_range.start = start;
+    G_range.bump  = start;
+    G_range.table = table;
+    G_range.shift = __builtin_ctzll(page);
+
+    atomic_store(&G_range.len, len);
+
+    return 1;
+}
+
+static void   _range_put(void* start, size_t bytes)
+{
+    // give [start, start + bytes) back to the range,
+    // and its pages back to the os
+
+    // Assume: bytes is a multiple of the page size
+
+    size_t page = (size_t)1 << G_range.shift;
+
+    _range_set(start, bytes, NULL);
+
+    munlock(start, bytes);
+    madvise(start, bytes, MADV_DONTNEED);
+    if (bytes > page)
+    {
+        mprotect((char*)start + page, bytes - page, PROT_NONE);
+    }
+
+    _range_lock();
+
+    if ((char*)start + bytes == G_range.bump)
+    {
+        G_range.bump = start;
+    }
+    else
+    {
+        _range_free* extent = start;
+        extent->next = G_range.free;
+        extent->sz   = bytes;
+        G_range.free = extent;
+    }
+
+    atomic_store(&G_range.is_free, MY_MALLOC_LOCK_FREE);
+}
+
+static void*  _range_get(size_t bytes)
+{
+    // take bytes from the range, a multiple of
+    // the page size
+    // return start of them, or null if the range
+    // has no room
+
+    /*  The end of the first free extent with room
+        is taken, so the extent keeps its place in
+        the list, then never handed out space.
+    */
+
+    _range_lock();
+
+    if (!_range_init())
+    {
+        // map on their own from now on
+
+        G_vars.reserve_sz = 0;
+        atomic_store(&G_range.is_free, MY_MALLOC_LOCK_FREE);
+
+        return NULL;
+    }
+
+    char* res = NULL;
+
+    for (_range_free** extent = &G_range.free; *extent; extent = &(*extent)->next)
+    {
+        if ((*extent)->sz >= bytes)
+        {
+            (*extent)->sz -= bytes;
+            res = (char*)*extent + (*extent)->sz;
+
+            if (!(*extent)->sz)
+            {
+                *extent = (*extent)->next;
+                memset(res, 0, sizeof(_range_free));
+            }
+            break;
+        }
+    }
+
+    if (!res && bytes <= (size_t)(G_range.start + G_range.len - G_range.bump))
+    {
+        res = G_range.bump;
+        G_range.bump += bytes;
+    }
+
+    atomic_store(&G_range.is_free, MY_MALLOC_LOCK_FREE);
+
+    if (!res)
+    {
+        return NULL;
+    }
+
+    if (mprotect(res, bytes, PROT_READ | PROT_WRITE))
+    {
+        _range_put(res, bytes);
+        return NULL;
+    }
+
+    // mappings start with their meta data
+
+    _range_set(res, bytes, (_mapping*)res);
+
+    return res;
+}
+
+static void*  _heap_map(size_t bytes)
+{
+    // get bytes for a mapping, from the range
+    // if there is one with room
+
+    // Assume: bytes is a multiple of the page size
+
+    void* res = NULL;
+
+    if (G_vars.reserve_sz)
+    {
+        // committing is timed like mapping
+
+        uint64_t start = G_vars.profile ? _prof_now() : 0;
+
+        res = _range_get(bytes);
+
+        if (start && res)
+        {
+            _prof_add(MY_MALLOC_LAT_MMAP, start);
+        }
+    }
+
+    return res ? res : _mem_get(bytes);
+}
+
+static void   _heap_unmap(void* start, size_t bytes)
+{
+    // give back a mapping from _heap_map
+
+    if (_range_owns(start))
+    {
+        _range_put(start, bytes);
+    }
+    else
+    {
+        munmap(start, bytes);
+    }
+}
+
+static void   _mem_populate(void* start, size_t bytes)
+{
+    // fault in every page of [start, start + bytes)
+
+#ifdef MADV_POPULATE_WRITE
+    if (!madvise(start, bytes, MADV_POPULATE_WRITE))
+    {
+        return;
+    }
+#endif
+
+    size_t page = sysconf(_SC_PAGESIZE);
+    for (size_t i = 0; i < bytes; i += page)
+    {
+        ((volatile char*)start)[i] = 0;
+    }
+}
+
+static int    _block_has_room(size_t bytes, _block* block)
+{
+    // whether block has enough room for bytes
+    // plus an allocation meta data
+    // return 1 if yes, 0 otherwise
+
+    return block->max_free >= bytes + MY_MALLOC_ALLOC_META;
+}
+
+static char*  _block_clean(void* block)
+{
+    // return first byte of block which has never
+    // been written
+
+    _block* block_ptr = block;
+
+    if (block_ptr->clean == UINT32_MAX)
+    {
+        return (char*)block + block_ptr->sz;
+    }
+
+    return (char*)block + block_ptr->clean;
+}
+
+static void   _block_dirty(void* block, void* upto)
+{
+    // mark everything in block before upto as written
+
+    _block* block_ptr = block;
+    size_t offset = (char*)upto - (char*)block;
+
+    if (offset > block_ptr->clean)
+    {
+        block_ptr->clean = offset < UINT32_MAX ? offset : UINT32_MAX;
+    }
+}
+
+static uint64_t* _index_starts(void* block)
+{
+    // bitmap of where nodes of block start, followed
+    // by the bitmap of which are in use
+
+    return (uint64_t*)((char*)block + sizeof(_block));
+}
+
+static size_t _index_end(void* block)
+{
+    // granule of the end of block
+
+    return ((char*)block + ((_block*)block)->sz - MY_MALLOC_BLOCK_NODES(block)) / MY_MALLOC_ALIGN;
+}
+
+static void   _index_mark(void* block, void* alloc_meta, int used)
+{
+    // note a node starting at alloc_meta, in use if
+    // used, in the index of block
+
+    _block* block_ptr = block;
+    if (!block_ptr->words)
+    {
+        return;
+    }
+
+    size_t at = ((char*)alloc_meta - MY_MALLOC_BLOCK_NODES(block)) / MY_MALLOC_ALIGN;
+    uint64_t* starts = _index_starts(block);
+    uint64_t bit = (uint64_t)1 << (at % 64);
+
+    starts[at / 64] |= bit;
+    if (used)
+    {
+        starts[block_ptr->words + (at / 64)] |= bit;
+    }
+    else
+    {
+        starts[block_ptr->words + (at / 64)] &= ~bit;
+    }
+}
+
+static void   _index_unmark(void* block, void* alloc_meta)
+{
+    // note alloc_meta no longer starts a node in the
+    // index of block
+
+    _block* block_ptr = block;
+    if (!block_ptr->words)
+    {
+        return;
+    }
+
+    size_t at = ((char*)alloc_meta - MY_MALLOC_BLOCK_NODES(block)) / MY_MALLOC_ALIGN;
+    uint64_t* starts = _index_starts(block);
+    uint64_t bit = (uint64_t)1 << (at % 64);
+
+    starts[at / 64] &= ~bit;
+    starts[block_ptr->words + (at / 64)] &= ~bit;
+}
+
+static size_t _index_scan(void* block, size_t from, int free)
+{
+    // find the first node of block starting at or
+    // after granule from, only free nodes if free
+    // return its granule, or the end if none
+
+    _block* block_ptr = block;
+    uint64_t* starts = _index_starts(block);
+    uint64_t* used = starts + block_ptr->words;
+
+    // a word at a time, bits past the end are never set
+    for (size_t i = from / 64; i < block_ptr->words; ++i)
+    {
+        uint64_t bits = starts[i] & (free ? ~used[i] : ~(uint64_t)0);
+        if (i == from / 64)
+        {
+            bits &= ~(uint64_t)0 << (from % 64);
+        }
+
+        if (bits)
+        {
+            return (i * 64) + MY_MALLOC_CTZ64(bits);
+        }
+    }
+
+    return _index_end(block);
+}
+
+static void*  _block_next_free(void* block, void* alloc_meta, size_t* sz)
+{
+    // find the first free node of block after
+    // alloc_meta, or the first of all if null, and
+    // set sz to its size
+    // return its allocation meta data, or null if none
+
+    _block* block_ptr = block;
+    char* nodes = MY_MALLOC_BLOCK_NODES(block);
+
+    if (block_ptr->words)
+    {
+        size_t from = alloc_meta ? (((char*)alloc_meta - nodes) / MY_MALLOC_ALIGN) + 1 : 0;
+        size_t at = _index_scan(block, from, 1);
+        if (at == _index_end(block))
+        {
+            return NULL;
+        }
+
+        *sz = ((_index_scan(block, at + 1, 0) - at) * MY_MALLOC_ALIGN) - MY_MALLOC_ALLOC_META;
+
+        return nodes + (at * MY_MALLOC_ALIGN);
+    }
+
+    char* end = (char*)block + block_ptr->sz;
+    void* curr = alloc_meta ? MY_MALLOC_NEXT(alloc_meta) : nodes;
+
+    for (; (char*)curr < end; curr = MY_MALLOC_NEXT(curr))
+    {
+        if (!MY_MALLOC_GET_AVAILABILITY(curr))
+        {
+            *sz = MY_MALLOC_GET_SIZE(curr);
+
+            return curr;
+        }
+    }
+
+    return NULL;
+}
+
+static void*  _block_next_node(void* block, void* alloc_meta, size_t* sz, int* in_use)
+{
+    // find the node of block after alloc_meta, or the
+    // first if null, and set sz to its size and in_use
+    // to whether it is, read from the index if block
+    // has one
+    // return its allocation meta data, or null if none
+
+    _block* block_ptr = block;
+    char* nodes = MY_MALLOC_BLOCK_NODES(block);
+
+    if (block_ptr->words)
+    {
+        size_t from = alloc_meta ? (((char*)alloc_meta - nodes) / MY_MALLOC_ALIGN) + 1 : 0;
+        size_t at = _index_scan(block, from, 0);
+        if (at == _index_end(block))
+        {
+            return NULL;
+        }
+
+        uint64_t* used = _index_starts(block) + block_ptr->words;
+
+        *in_use = !!(used[at / 64] & ((uint64_t)1 << (at % 64)));
+        *sz = ((_index_scan(block, at + 1, 0) - at) * MY_MALLOC_ALIGN) - MY_MALLOC_ALLOC_META;
+
+        return nodes + (at * MY_MALLOC_ALIGN);
+    }
+
+    void* curr = alloc_meta ? MY_MALLOC_NEXT(alloc_meta) : nodes;
+    if ((char*)curr >= (char*)block + block_ptr->sz)
+    {
+        return NULL;
+    }
+
+    *in_use = !!MY_MALLOC_GET_AVAILABILITY(curr);
+    *sz = MY_MALLOC_GET_SIZE(curr);
+
+    return curr;
+}
+
+static void   _index_run(void* alloc_meta, size_t sz, void** max, size_t* max_sz)
+{
+    // end a run of free nodes merged into alloc_meta,
+    // which now has sz bytes, keeping the largest
+
+    if (MY_MALLOC_GET_SIZE(alloc_meta) != sz)
+    {
+        MY_MALLOC_SET_SIZE(alloc_meta, sz);
+    }
+
+    if (!*max || sz > *max_sz)
+    {
+        *max = alloc_meta;
+        *max_sz = sz;
+    }
+}
+
+static void   _index_update_meta(void* block)
+{
+    // update the block meta data from the index,
+    // merging free nodes as _block_update_meta does
+
+    /*  Sizes come from where the next node starts, so
+        only the size of a node which absorbed others
+        is written.
+    */
+
+    _block* block_ptr = block;
+    uint64_t* starts = _index_starts(block);
+    uint64_t* used = starts + block_ptr->words;
+    char* nodes = MY_MALLOC_BLOCK_NODES(block);
+
+    size_t end = _index_end(block);
+    size_t run = end;
+    void* max = NULL;
+    size_t max_sz = 0;
+
+    for (size_t i = 0; i != block_ptr->words; ++i)
+    {
+        for (uint64_t bits = starts[i]; bits; bits &= bits - 1)
+        {
+            size_t bit = MY_MALLOC_CTZ64(bits);
+            size_t at = (i * 64) + bit;
+
+            if (!((used[i] >> bit) & 1))
+            {
+                if (run == end)
+                {
+                    run = at;
+                }
+                else
+                {
+                    starts[i] &= ~((uint64_t)1 << bit);
+                }
+            }
+            else if (run != end)
+            {
+                _index_run(nodes + (run * MY_MALLOC_ALIGN), ((at - run) * MY_MALLOC_ALIGN) - MY_MALLOC_ALLOC_META, &max, &max_sz);
+                run = end;
+            }
+        }
+    }
+
+    if (run != end)
+    {
+        _index_run(nodes + (run * MY_MALLOC_ALIGN), ((end - run) * MY_MALLOC_ALIGN) - MY_MALLOC_ALLOC_META, &max, &max_sz);
+    }
+
+    block_ptr->max_free = max_sz;
+    block_ptr->max_free_ptr = max;
+}
+
+static void   _block_update_meta(void* block)
+{
+    // update the block meta data to reflect
+    // information in the allocation meta data's
+
+    /*  Algorithm explained.
+
+        Instead of using this representation
+            (sz_1,used) -> (sz_2,free) -> (sz_3,used) ->
+        Use the following, which only shows whether
+        a node is U(sed) or F(ree)
+            U -> F -> U ->
+
+
+
+        This function is called after any number of
+        manipulations have been done to a block. The
+        point is to correctly update block and
+        allocation meta data to a state such that the
+        block is valid.
+
+        A valid block meets all the conditions
+            - block meta data is correct
+            - no two consecutive nodes are free
+
+        Loop through all nodes once. When a free node
+        is found, every free node directly after it
+        is merged into it
+                U -> F -> F -> F -> U ->
+            becomes
+                U -> F -> U ->
+        and the largest free node seen so far is
+        kept. Meta data is updated at the end.
+
+        Blocks with an index do the same on the index
+        instead, see _index_update_meta.
+    */
+
+    _block* block_ptr = block;
+
+    block_ptr->touched = atomic_load_explicit(&G_decay_now, memory_order_relaxed);
+    block_ptr->flags &= ~MY_MALLOC_BLOCK_PURGED;
+    block_ptr->pending = 0;
+
+    if (block_ptr->words)
+    {
+        _index_update_meta(block);
+
+        return;
+    }
+
+    char* end = (char*)block + block_ptr->sz;
+    void* curr = MY_MALLOC_BLOCK_NODES(block);
+    void* max = NULL;
+
+    while ((char*)curr < end)
+    {
+        if (!MY_MALLOC_GET_AVAILABILITY(curr))
+        {
+            void* next = MY_MALLOC_NEXT(curr);
+
+            while ((char*)next < end && !MY_MALLOC_GET_AVAILABILITY(next))
+            {
+                MY_MALLOC_SET_SIZE(curr, MY_MALLOC_GET_SIZE(curr) + MY_MALLOC_GET_SIZE(next) + MY_MALLOC_ALLOC_META);
+                next = MY_MALLOC_NEXT(curr);
+            }
+
+            if (!max || MY_MALLOC_GET_SIZE(curr) > MY_MALLOC_GET_SIZE(max))
+            {
+                max = curr;
+            }
+        }
+
+        curr = MY_MALLOC_NEXT(curr);
+    }
+
+    block_ptr->max_free = max ? MY_MALLOC_GET_SIZE(max) : 0;
+    block_ptr->max_free_ptr = max;
+}
+
+static int    _block_merge_later(void* block, void* alloc_meta)
+{
+    // note alloc_meta of block was just set free,
+    // leaving it unmerged until G_vars.coalesce
+    // frees are pending
+    // return 1 if merging can wait, 0 if block
+    // needs _block_update_meta now
+
+    // Assume: block is held
+
+    /*  Until merged, the node is a free space of its
+        own, so max_free only needs to grow to it for
+        searches to see the room. A run of free nodes
+        is merged whole later, so the run is found by
+        _heap_coalesce when no node alone is enough.
+    */
+
+    _block* block_ptr = block;
+
+    if (!G_vars.coalesce || ++block_ptr->pending >= G_vars.coalesce)
+    {
+        return 0;
+    }
+
+    if (MY_MALLOC_GET_SIZE(alloc_meta) > block_ptr->max_free)
+    {
+        block_ptr->max_free = MY_MALLOC_GET_SIZE(alloc_meta);
+        block_ptr->max_free_ptr = alloc_meta;
+    }
+
+    block_ptr->touched = atomic_load_explicit(&G_decay_now, memory_order_relaxed);
+    block_ptr->flags &= ~MY_MALLOC_BLOCK_PURGED;
+
+    return 1;
+}
+
+static void   _block_count(void* block, size_t from, size_t to)
+{
+    // note an allocation of block went from from
+    // bytes in use to to, 0 when not in use
+
+    // Assume: block is held
+
+    /*  Large blocks are unmapped when freed, so
+        the publish thread can not read them. They
+        count on their heap instead.
+    */
+
+    _block* block_ptr = block;
+
+    if (block_ptr->flags & MY_MALLOC_BLOCK_LARGE)
+    {
+        // the block is in the first page of the mapping
+        size_t page = sysconf(_SC_PAGESIZE);
+        _heap* heap = ((_mapping*)((uintptr_t)block & ~(page - 1)))->heap;
+
+        atomic_fetch_add_explicit(&heap->large, to - from, memory_order_relaxed);
+
+        return;
+    }
+
+    size_t used = atomic_load_explicit(&block_ptr->used, memory_order_relaxed);
+    unsigned nodes = atomic_load_explicit(&block_ptr->used_nodes, memory_order_relaxed);
+
+    atomic_store_explicit(&block_ptr->used, used + to - from, memory_order_relaxed);
+    atomic_store_explicit(&block_ptr->used_nodes, nodes + !!to - !!from, memory_order_relaxed);
+}
+
+static void   _block_drain(void* block)
+{
+    // free every allocation on the thread free
+    // list of block
+
+    // Assume: block is held
+
+    _block* block_ptr = block;
+
+    if (!atomic_load_explicit(&block_ptr->thread_free, memory_order_relaxed))
+    {
+        return;
+    }
+
+    void* ptr = atomic_exchange_explicit(&block_ptr->thread_free, NULL, memory_order_acquire);
+    int merge = 0;
+
+    while (ptr)
+    {
+        void* next = *(void**)ptr;
+        void* alloc_meta = (char*)ptr - MY_MALLOC_ALLOC_META;
+
+        if (G_vars.trim_sz && MY_MALLOC_GET_SIZE(alloc_meta) >= G_vars.trim_sz)
+        {
+            _mem_trim(ptr, MY_MALLOC_GET_SIZE(alloc_meta));
+        }
+
+        _block_count(block, MY_MALLOC_GET_SIZE(alloc_meta), 0);
+        MY_MALLOC_SET_FREE(alloc_meta);
+        _index_mark(block, alloc_meta, 0);
+        merge |= !_block_merge_later(block, alloc_meta);
+        ptr = next;
+    }
+
+    if (merge)
+    {
+        _block_update_meta(block);
+    }
+}
+
+static void   _block_defer(void* block, void* ptr)
+{
+    // push ptr onto the thread free list of block
+
+    _block* block_ptr = block;
+
+    // ordered before the holder letting go, see _block_lock_free
+    *(void**)ptr = atomic_load_explicit(&block_ptr->thread_free, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&block_ptr->thread_free, (void**)ptr, ptr, memory_order_seq_cst, memory_order_relaxed));
+
+    atomic_fetch_add_explicit(&block_ptr->deferred, 1, memory_order_relaxed);
+}
+
+static void   _block_lock_free(void* block)
+{
+    // make the block available for modification,
+    // first freeing what was left on it while held
+
+    /*  A free finding the block held pushes onto
+        thread_free, then tries to take the block
+        itself. The holder checks thread_free again
+        after letting go, so one of the two drains
+        it. Otherwise a full block, which searches
+        never take, would keep the freed memory
+        until some other free came along.
+    */
+
+    _block* block_ptr = block;
+
+    for (;;)
+    {
+        _block_drain(block);
+
+        atomic_store(&block_ptr->is_free, MY_MALLOC_LOCK_FREE);
+
+        if (!atomic_load(&block_ptr->thread_free))
+        {
+            return;
+        }
+
+        char expected = MY_MALLOC_LOCK_FREE;
+        if (!atomic_compare_exchange_strong(&block_ptr->is_free, &expected, MY_MALLOC_LOCK_INSUSE))
+        {
+            // the new holder drains it
+            return;
+        }
+    }
+}
+
+static int    _block_acquire(size_t bytes, void* block)
+{
+    // acquire sole access to a block so that the
+    // block has bytes space available
+    // return 1 if successful
+
+    _block* block_ptr = block;
+    char expected = MY_MALLOC_LOCK_FREE;
+
+    if (atomic_compare_exchange_strong(&block_ptr->is_free, &expected, MY_MALLOC_LOCK_INSUSE))
+    {
+        _block_drain(block);
+
+        // verify available space after obtained lock
+        if (_block_has_room(bytes, block))
+        {
+            return 1;
+        }
+
+        _block_lock_free(block);
+
+        return 0;
+    }
+
+    atomic_fetch_add_explicit(&block_ptr->fails, 1, memory_order_relaxed);
+
+    return 0;
+}
+
+static void   _block_lock(void* block)
+{
+    // wait for sole access to a block no matter
+    // how much room it has
+
+    _block* block_ptr = block;
+    char expected = MY_MALLOC_LOCK_FREE;
+
+    while (!atomic_compare_exchange_strong(&block_ptr->is_free, &expected, MY_MALLOC_LOCK_INSUSE))
+    {
+        expected = MY_MALLOC_LOCK_FREE;
+        atomic_fetch_add_explicit(&block_ptr->spins, 1, memory_order_relaxed);
+        _wait_short();
+    }
+
+    _block_drain(block);
+}
+
+static void*  _block_fit(size_t bytes, void* block, size_t* fit_sz)
+{
+    // find the free space in block to allocate bytes
+    // from, going by G_vars.fit, and set fit_sz to
+    // its size
+    // return its allocation meta data
+
+    // Assume: bytes <= block.max_free - ALLOC_META
+
+    _block* block_ptr = block;
+
+    if (G_vars.fit == MY_MALLOC_FIT_FIRST)
+    {
+        // largest space, known without a search
+        *fit_sz = block_ptr->max_free;
+        return block_ptr->max_free_ptr;
+    }
+
+    void* first = NULL;
+    size_t first_sz = 0;
+    void* best = block_ptr->max_free_ptr;
+    size_t best_sz = block_ptr->max_free;
+
+    void* recent = G_vars.fit == MY_MALLOC_FIT_LIFO && block == G_recent_block ? G_recent : NULL;
+
+    size_t sz;
+    for (void* curr = _block_next_free(block, NULL, &sz); curr; curr = _block_next_free(block, curr, &sz))
+    {
+        if (sz < bytes + MY_MALLOC_ALLOC_META)
+        {
+            continue;
+        }
+
+        if (G_vars.fit == MY_MALLOC_FIT_BEST)
+        {
+            if (sz == bytes + MY_MALLOC_ALLOC_META)
+            {
+                *fit_sz = sz;
+                return curr;
+            }
+
+            if (sz < best_sz)
+            {
+                best = curr;
+                best_sz = sz;
+            }
+        }
+        else if (!recent || curr == recent)
+        {
+            *fit_sz = sz;
+            return curr;
+        }
+        else if (!first)
+        {
+            first = curr;
+            first_sz = sz;
+        }
+    }
+
+    *fit_sz = first ? first_sz : best_sz;
+
+    return first ? first : best;
+}
+
+static void*  _block_alloc_unsafe(size_t bytes, void* block, char zero)
+{
+    // allocate bytes from block and update the largest possible
+    // allocation in block
+    // zero the allocation if indicated
+    // return the start of allocation
+
+    // Assume: bytes <= block.max_free - ALLOC_META
+
+    size_t sz;
+    void* alloc_meta = _block_fit(bytes, block, &sz);
+    void* alloc_start = (char*)alloc_meta + MY_MALLOC_ALLOC_META;
+
+    /*  Always add another allocation meta data.
+
+        For exmaple
+        (1500,used) -> (1000,free) -> (2000,used) -> ...
+        Can turn into
+        (1500,used) -> (984,used) -> (0,free) -> (2000,used) -> ...
+
+        Point is, an allocation meta data will
+        always be added to maintain structure. Even
+        at the cost of wasted space.
+    */
+    size_t remaining = sz - bytes - MY_MALLOC_ALLOC_META;
+
+    if (zero)
+    {
+        // only what was written before needs zeroing
+
+        char* clean = _block_clean(block);
+        if ((char*)alloc_start < clean)
+        {
+            char* alloc_end = (char*)alloc_start + bytes;
+            _mem_zero(alloc_start, (clean < alloc_end ? clean : alloc_end) - (char*)alloc_start);
+        }
+    }
+
+    MY_MALLOC_SET_INUSE(alloc_meta, block);
+    MY_MALLOC_SET_SIZE(alloc_meta, bytes);
+    _index_mark(block, alloc_meta, 1);
+    _block_count(block, 0, bytes);
+
+    // set up meta data for another allocation
+    void* after_insert = MY_MALLOC_NEXT(alloc_meta);
+    MY_MALLOC_SET_FREE(after_insert);
+    MY_MALLOC_SET_SIZE(after_insert, remaining);
+    _index_mark(block, after_insert, 0);
+
+    _block_dirty(block, (char*)after_insert + MY_MALLOC_ALLOC_META);
+
+    _block_update_meta(block);
+
+    return alloc_start;
+}
+
+static void   _block_create_unsafe(size_t sz, void* where, char flags)
+{
+    // create a block of sz with flags starting the
+    // block on where
+
+    _block* block_ptr = (_block*)where;
+
+    // large blocks only ever hold one allocation
+    size_t words = flags & MY_MALLOC_BLOCK_LARGE ? 0 : MY_MALLOC_INDEX_WORDS(sz);
+    size_t head = sizeof(_block) + (2 * sizeof(uint64_t) * words);
+
+    /*  Create the block with a meta data subtracted since
+        initialzation requires two meta data's, but all
+        other cases require one.
+    */
+    _block new_block =
+    {
+        .sz           = sz,
+        .is_free      = 1,
+        .flags        = flags,
+        .clean        = head + MY_MALLOC_ALLOC_META,
+        .next         = NULL,
+        .owner        = NULL,
+        .max_free_ptr = (char*)where + head,
+        .max_free     = sz - head - MY_MALLOC_ALLOC_META,
+        .thread_free  = NULL,
+        .fails        = 0,
+        .spins        = 0,
+        .deferred     = 0,
+        .used         = 0,
+        .used_nodes   = 0,
+        .touched      = atomic_load_explicit(&G_decay_now, memory_order_relaxed),
+        .words        = words,
+        .pending      = 0
+    };
+
+    *block_ptr = new_block;
+
+    memset(_index_starts(where), 0, head - sizeof(_block));
+
+    void* initial_alloc = (char*)where + head;
+    MY_MALLOC_SET_FREE(initial_alloc);
+    MY_MALLOC_SET_SIZE(initial_alloc, block_ptr->max_free);
+    _index_mark(where, initial_alloc, 0);
+}
+
+static void   _heap_lock(_heap* heap)
+{
+    // wait for sole access to the mappings of heap
+
+    char expected = MY_MALLOC_LOCK_FREE;
+    while (!atomic_compare_exchange_strong(&heap->is_free, &expected, MY_MALLOC_LOCK_INSUSE))
+    {
+        expected = MY_MALLOC_LOCK_FREE;
+        atomic_fetch_add_explicit(&heap->fails, 1, memory_order_relaxed);
+        _wait_long();
+    }
+}
+
+static _heap* _heap_arena()
+{
+    // heap the calling thread uses for my_malloc
+
+    if (!G_arena)
+    {
+        G_arena = &G_arenas[atomic_fetch_add(&G_next_arena, 1) % G_vars.arenas];
+    }
+
+    return G_arena;
+}
+
+static void*  _block_get(size_t bytes, _mapping** mapping, void* block)
+{
+    // try to get a block with enough bytes, starting
+    // from block in mapping or the first block of
+    // mapping if block is NULL
+    // return block if found, otherwise null
+
+    // Note: never want *mapping to be set to NULL
+    //       unless is was passed as null
+
+    if (!(*mapping))
+    {
+        return NULL;
+    }
+
+    if (!block)
+    {
+        block = (*mapping)->start_block;
+    }
+
+    while (1)
+    {
+        while (block)
+        {
+            if (_block_has_room(bytes, block)) // && _block_lock_acquire
+            {
+                return block;
+            }
+
+            block = ((_block*)block)->next;
+        }
+
+        if (!(*mapping)->next)
+        {
+            return NULL;
+        }
+
+        *mapping = (*mapping)->next;
+        block = (*mapping)->start_block;
+    }
+}
+
+static void*  _block_get_best(size_t bytes, _heap* heap)
+{
+    // get the block of heap with the least room
+    // which has enough bytes
+    // return block if found, otherwise null
+
+    void* best = NULL;
+
+    for (_mapping* mapping = heap->start_map; mapping; mapping = mapping->next)
+    {
+        for (_block* block = mapping->start_block; block; block = block->next)
+        {
+            if (_block_has_room(bytes, block) && (!best || block->max_free < ((_block*)best)->max_free))
+            {
+                if (block->max_free == bytes + MY_MALLOC_ALLOC_META)
+                {
+                    return block;
+                }
+
+                best = block;
+            }
+        }
+    }
+
+    return best;
+}
+
+static _map   _mapping_find(void* ptr, _heap* heap, int large)
+{
+    // find the mapping of heap which ptr is in,
+    // searching large mappings only if large
+    // return mapping, or null if in none
+
+    // Assume: heap is held if large
+
+    /*  In the range the first page of a mapping stays
+        accessible after it is unmapped, and is zero,
+        so reading a stale entry is safe.
+    */
+
+    if (_range_owns(ptr))
+    {
+        _mapping* mapping = _range_mapping(ptr);
+        return mapping && mapping->heap == heap ? mapping : NULL;
+    }
+
+    _mapping* lists[] = { heap->start_map, large ? heap->large_map : NULL };
+
+    for (size_t i = 0; i != sizeof(lists) / sizeof(lists[0]); ++i)
+    {
+        for (_mapping* mapping = lists[i]; mapping; mapping = mapping->next)
+        {
+            if ((char*)ptr >= (char*)mapping->start && (char*)ptr < (char*)mapping->end)
+            {
+                return mapping;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static void*  _block_get_recent(size_t bytes, _heap* heap)
+{
+    // get the block the calling thread freed in
+    // last if it is in heap and has enough bytes
+    // return block if found, otherwise null
+
+    // only look at blocks known to be in heap, the
+    // one freed in may have been unmapped since
+
+    _mapping* mapping = _mapping_find(G_recent_block, heap, 0);
+    if (!mapping)
+    {
+        return NULL;
+    }
+
+    for (_block* block = mapping->start_block; block; block = block->next)
+    {
+        if (block == G_recent_block)
+        {
+            return _block_has_room(bytes, block) ? block : NULL;
+        }
+    }
+
+    return NULL;
+}
+
+static void*  _block_fit_get(size_t bytes, _heap* heap)
+{
+    // try to get a block of heap with enough bytes,
+    // going by G_vars.fit
+    // return block if found, otherwise null
+
+    _mapping* mapping = heap->start_map;
+    void* block = NULL;
+
+    switch (G_vars.fit)
+    {
+        case MY_MALLOC_FIT_BEST:
+            return _block_get_best(bytes, heap);
+        case MY_MALLOC_FIT_NEXT:
+            if (heap->rover)
+            {
+                // wrap around to the start if nothing after
+                mapping = heap->rover_map;
+                block = _block_get(bytes, &mapping, heap->rover);
+                if (!block)
+                {
+                    mapping = heap->start_map;
+                    block = _block_get(bytes, &mapping, NULL);
+                }
+            }
+            else
+            {
+                block = _block_get(bytes, &mapping, NULL);
+            }
+            if (block)
+            {
+                heap->rover = block;
+                heap->rover_map = mapping;
+            }
+            return block;
+        case MY_MALLOC_FIT_LIFO:
+            block = _block_get_recent(bytes, heap);
+            if (block)
+            {
+                return block;
+            }
+            break;
+    }
+
+    return _block_get(bytes, &mapping, NULL);
+}
+
+static void   _block_home_set(_block* block)
+{
+    // make block, owned by the calling thread, where
+    // its small allocations go first
+
+    if (!G_home)
+    {
+        // owned blocks are given up on exit
+        _tcache_register();
+    }
+
+    G_home = block;
+}
+
+static void*  _block_get_home(size_t bytes, _heap* heap)
+{
+    // get the calling thread's home block in heap if
+    // it has enough bytes, otherwise the first block
+    // with enough bytes it owns or can claim
+    // return block if found, otherwise null
+
+    // Assume: heap is the calling thread's arena
+
+    if (G_home && _block_has_room(bytes, G_home))
+    {
+        return G_home;
+    }
+
+    for (_mapping* mapping = heap->start_map; mapping; mapping = mapping->next)
+    {
+        for (_block* block = mapping->start_block; block; block = block->next)
+        {
+            if (!_block_has_room(bytes, block))
+            {
+                continue;
+            }
+
+            // only read owner first, a claim writes its line
+
+            void* owner = atomic_load_explicit(&block->owner, memory_order_relaxed);
+            if
+            (
+                owner == &G_token
+                ||
+                (!owner && atomic_compare_exchange_strong(&block->owner, &owner, &G_token))
+            )
+            {
+                _block_home_set(block);
+
+                return block;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static int    _block_foreign(void* ptr)
+{
+    // whether ptr is in a block another thread owns
+    // return 1 if yes, 0 otherwise
+
+    _block* block = MY_MALLOC_GET_AVAILABILITY((char*)ptr - MY_MALLOC_ALLOC_META);
+    void* owner = atomic_load_explicit(&block->owner, memory_order_relaxed);
+
+    return owner && owner != &G_token;
+}
+
+static void   _block_home_release()
+{
+    // give up every block the calling thread owns
+
+    if (!G_home)
+    {
+        return;
+    }
+
+    for (_mapping* mapping = G_arena->start_map; mapping; mapping = mapping->next)
+    {
+        for (_block* block = mapping->start_block; block; block = block->next)
+        {
+            void* owner = &G_token;
+            atomic_compare_exchange_strong(&block->owner, &owner, NULL);
+        }
+    }
+
+    G_home = NULL;
+}
+
+static char*  _mapping_inuse_end(_mapping* mapping)
+{
+    // first byte of mapping not taken by a block
+
+    _block* end_block = mapping->end_block;
+
+    if (!end_block)
+    {
+        // reserved, nothing in it yet
+        return (char*)mapping + sizeof(_mapping);
+    }
+
+    return (char*)end_block + end_block->sz;
+}
+
+static int    _mapping_has_room(size_t block_sz, _mapping* mapping)
+{
+    // whether mapping has enough room for bytes
+    // return 1 if yes, 0 otherwise
+
+    char* inuse_end = _mapping_inuse_end(mapping);
+
+    return block_sz <= (size_t)((char*)mapping->end - inuse_end);
+}
+
+static size_t _heap_more_sz(size_t bytes, _heap* heap)
+{
+    // determine number of new bytes to map for heap
+
+    /*  Doubling until as large as what heap has
+        mapped keeps the number of mappings
+        logarithmic in the size of the heap. Freeing
+        large allocations lowers what is mapped, so
+        sizes shrink again.
+    */
+
+    size_t sz = _mem_more_sz(bytes);
+
+    size_t mapped = atomic_load_explicit(&heap->mapped, memory_order_relaxed);
+
+    while (sz < mapped && sz < G_vars.grow_max && sz <= SIZE_MAX / 2)
+    {
+        sz <<= 1;
+    }
+
+    return sz;
+}
+
+static _map   _mapping_create_unsafe(size_t sz, _heap* heap)
+{
+    // create mapping capable of holding sz
+    // return where the mapping is created
+
+    size_t more_mem = _heap_more_sz(sz + sizeof(_mapping), heap);
+    void* start = _heap_map(more_mem);
+    if (!start)
+    {
+        return NULL;
+    }
+
+    _mapping new_mapping =
+    {
+        .start       = start,
+        .end         = (char*)start + more_mem,
+        .start_block = NULL,
+        .end_block   = NULL,
+        .next        = NULL,
+        .prev        = NULL,
+        .heap        = heap
+    };
+    _mapping* mapping = start;
+    *mapping = new_mapping;
+
+    atomic_fetch_add_explicit(&heap->mapped, more_mem, memory_order_relaxed);
+    atomic_fetch_add_explicit(&heap->num_mmap, 1, memory_order_relaxed);
+
+    return start;
+}
+
+static void*  _mapping_create(size_t bytes, _heap* heap, char zero, void* owner)
+{
+    // request a mapping with bytes allocated onto it
+    // in a block owned by owner and add it to the
+    // end of heap
+    // return the start of allocation
+
+    // Assume: heap is held
+
+    size_t block_sz = MY_MALLOC_BLOCK_EXPANSION(bytes);
+    _mapping* new_mapping = _mapping_create_unsafe(block_sz + sizeof(_mapping), heap);
+    if (!new_mapping)
+    {
+        return NULL;
+    }
+
+    void* where = (char*)new_mapping + sizeof(_mapping);
+
+    _block_create_unsafe(block_sz, where, 0);
+    ((_block*)where)->owner = owner;
+
+    new_mapping->start_block = where;
+    new_mapping->end_block = where;
+
+    void* res = _block_alloc_unsafe(bytes, where, zero);
+
+    // searching threads must see a complete mapping
+    atomic_thread_fence(memory_order_release);
+
+    if (heap->end_map)
+    {
+        heap->end_map->next = new_mapping;
+    }
+    else
+    {
+        heap->start_map = new_mapping;
+    }
+    heap->end_map = new_mapping;
+
+    return res;
+}
+
+static void*  _mapping_append_block(size_t bytes, _mapping* mapping, char zero, void* owner)
+{
+    // add block owned by owner with bytes allocated
+    // onto it to the end of mapping
+    // return the start of allocation
+
+    // Assume: mapping has enough room for the block
+    //         and its heap is held
+
+    _block* end_block = mapping->end_block;
+    void* new_block = _mapping_inuse_end(mapping);
+    
+    _block_create_unsafe(MY_MALLOC_BLOCK_EXPANSION(bytes), new_block, 0);
+    ((_block*)new_block)->owner = owner;
+
+    void* res = _block_alloc_unsafe(bytes, new_block, zero);
+
+    // searching threads must see a complete block
+    atomic_thread_fence(memory_order_release);
+
+    mapping->end_block = new_block;
+    if (end_block)
+    {
+        end_block->next = new_block;
+    }
+    else
+    {
+        mapping->start_block = new_block;
+    }
+
+    return res;
+}
+
+static int    _mapping_reserve(size_t bytes, _heap* heap, int flags)
+{
+    // add a mapping with room for atleast bytes of
+    // blocks to the end of heap
+    // return 1 if successful
+
+    if (flags & ~(MY_MALLOC_RESERVE_POPULATE | MY_MALLOC_RESERVE_LOCK))
+    {
+        return 0;
+    }
+
+    size_t page = sysconf(_SC_PAGESIZE);
+    if (bytes > SIZE_MAX - sizeof(_mapping) - page)
+    {
+        return 0;
+    }
+    size_t sz = MY_MALLOC_ROUND(bytes + sizeof(_mapping), page);
+
+    _mapping* mapping = G_vars.reserve_sz ? _range_get(sz) : NULL;
+    if (mapping)
+    {
+        if (flags & MY_MALLOC_RESERVE_LOCK && mlock(mapping, sz))
+        {
+            _range_put(mapping, sz);
+            return 0;
+        }
+        if (flags & MY_MALLOC_RESERVE_POPULATE)
+        {
+            _mem_populate(mapping, sz);
+        }
+    }
+    else
+    {
+        int mmap_flags = MAP_PRIVATE | MAP_ANONYMOUS;
+        if (flags & MY_MALLOC_RESERVE_POPULATE)
+        {
+            mmap_flags |= MAP_POPULATE;
+        }
+        if (flags & MY_MALLOC_RESERVE_LOCK)
+        {
+            mmap_flags |= MAP_LOCKED;
+        }
+
+        mapping = mmap(NULL, sz, PROT_READ | PROT_WRITE, mmap_flags, -1, 0);
+        if (mapping == (void*)-1)
+        {
+            return 0;
+        }
+    }
+
+    /*  Blocks are made in the mapping as allocations
+        need them, like any other mapping. Whatever
+        room the previous last mapping had is left
+        unused.
+    */
+
+    _mapping new_mapping =
+    {
+        .start       = mapping,
+        .end         = (char*)mapping + sz,
+        .start_block = NULL,
+        .end_block   = NULL,
+        .next        = NULL,
+        .prev        = NULL,
+        .heap        = heap
+    };
+    *mapping = new_mapping;
+
+    _heap_lock(heap);
+
+    if (heap->end_map)
+    {
+        heap->end_map->next = mapping;
+    }
+    else
+    {
+        heap->start_map = mapping;
+    }
+    heap->end_map = mapping;
+
+    atomic_fetch_add_explicit(&heap->mapped, sz, memory_order_relaxed);
+    atomic_fetch_add_explicit(&heap->num_mmap, 1, memory_order_relaxed);
+
+    atomic_store(&heap->is_free, MY_MALLOC_LOCK_FREE);
+
+    return 1;
+}
+
+static void*  _large_alloc(size_t bytes, _heap* heap, size_t align)
+{
+    // allocate bytes on a mapping of its own,
+    // aligned to align if more than MY_MALLOC_ALIGN
+    // return start of allocation
+
+    /*  The mapping holds one block which has room for
+        exactly the one allocation and the trailing
+        allocation meta data every block needs. The
+        allocation is given the rest of the last page.
+        To align it, the block starts further in, but
+        always in the first page.
+    */
+
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t head = MY_MALLOC_LARGE_META - MY_MALLOC_ALLOC_META;
+    size_t pad = align > MY_MALLOC_ALIGN ? MY_MALLOC_ROUND(head, align) - head : 0;
+
+    if (bytes > SIZE_MAX - MY_MALLOC_LARGE_META - pad - page)
+    {
+        return NULL;
+    }
+    size_t sz = MY_MALLOC_ROUND(bytes + MY_MALLOC_LARGE_META + pad, page);
+
+    _mapping* mapping = _heap_map(sz);
+    if (!mapping)
+    {
+        return NULL;
+    }
+
+    void* where = (char*)mapping + sizeof(_mapping) + pad;
+
+    _mapping new_mapping =
+    {
+        .start       = mapping,
+        .end         = (char*)mapping + sz,
+        .start_block = where,
+        .end_block   = where,
+        .next        = NULL,
+        .prev        = NULL,
+        .heap        = heap
+    };
+    *mapping = new_mapping;
+
+    _block_create_unsafe(sz - sizeof(_mapping) - pad, where, MY_MALLOC_BLOCK_LARGE);
+
+    void* res = _block_alloc_unsafe(sz - MY_MALLOC_LARGE_META - pad, where, 0);
+
+    _heap_lock(heap);
+
+    mapping->next = heap->large_map;
+    if (heap->large_map)
+    {
+        heap->large_map->prev = mapping;
+    }
+    heap->large_map = mapping;
+
+    atomic_fetch_add_explicit(&heap->mapped, sz, memory_order_relaxed);
+    atomic_fetch_add_explicit(&heap->num_mmap, 1, memory_order_relaxed);
+
+    atomic_store(&heap->is_free, MY_MALLOC_LOCK_FREE);
+
+    return res;
+}
+
+static void   _large_free(void* block)
+{
+    // unmap the mapping which large block is in
+
+    // the block is in the first page of the mapping
+    size_t page = sysconf(_SC_PAGESIZE);
+    _mapping* mapping = (_mapping*)((uintptr_t)block & ~(page - 1));
+    _heap* heap = mapping->heap;
+    size_t sz = (char*)mapping->end - (char*)mapping->start;
+    size_t large = MY_MALLOC_GET_SIZE(MY_MALLOC_BLOCK_NODES(block));
+
+    _heap_lock(heap);
+
+    if (mapping->prev)
+    {
+        mapping->prev->next = mapping->next;
+    }
+    else
+    {
+        heap->large_map = mapping->next;
+    }
+    if (mapping->next)
+    {
+        mapping->next->prev = mapping->prev;
+    }
+
+    atomic_fetch_sub_explicit(&heap->mapped, sz, memory_order_relaxed);
+    atomic_fetch_add_explicit(&heap->num_munmap, 1, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&heap->large, large, memory_order_relaxed);
+
+    atomic_store(&heap->is_free, MY_MALLOC_LOCK_FREE);
+
+    uint64_t start = G_vars.profile ? _prof_now() : 0;
+
+    _heap_unmap(mapping->start, sz);
+
+    if (start)
+    {
+        _prof_add(MY_MALLOC_LAT_MMAP, start);
+    }
+}
+
+static int    _heap_coalesce(size_t bytes, _heap* heap)
+{
+    // merge the pending frees of every block of heap
+    // not taken right now
+    // return 1 if a block merged has room for bytes
+
+    int found = 0;
+
+    for (_mapping* mapping = heap->start_map; mapping; mapping = mapping->next)
+    {
+        for (_block* block = mapping->start_block; block; block = block->next)
+        {
+            char expected = MY_MALLOC_LOCK_FREE;
+
+            if (!block->pending || !atomic_compare_exchange_strong(&block->is_free, &expected, MY_MALLOC_LOCK_INSUSE))
+            {
+                continue;
+            }
+
+            _block_drain(block);
+
+            if (block->pending)
+            {
+                _block_update_meta(block);
+                found |= _block_has_room(bytes, block);
+            }
+
+            _block_lock_free(block);
+        }
+    }
+
+    return found;
+}
+
+static void*  _heap_grow(size_t bytes, _heap* heap, char zero, void* owner)
+{
+    // add a block owned by owner with bytes allocated
+    // onto it to the end of heap
+    // return the start of allocation
+
+    // Assume: heap is held
+
+    size_t block_sz = MY_MALLOC_BLOCK_EXPANSION(bytes);
+    _mapping* mapping = heap->end_map;
+
+    if (!mapping || !_mapping_has_room(block_sz, mapping))
+    {
+        // mapping is null or does not have enough room
+        // for a new block of necessary size
+
+        return _mapping_create(bytes, heap, zero, owner);
+    }
+
+    return _mapping_append_block(bytes, mapping, zero, owner);
+}
+
+static void*  _advanced_malloc(size_t bytes, char search, _heap* heap, char zero)
+{
+    // get an allocation of bytes from heap
+    // only search for block if indicated
+
+    /*  NEED depth limiter on search
+    */
+
+    if (search)
+    {
+        void* block_res = _block_fit_get(bytes, heap);
+
+        if (block_res)
+        {
+            if (_block_acquire(bytes, block_res))
+            {
+                void* res = _block_alloc_unsafe(bytes, block_res, zero);
+                _block_lock_free(block_res);
+
+                return res;
+            }
+        }
+    }
+
+    if (G_vars.coalesce && _heap_coalesce(bytes, heap))
+    {
+        // merging made room, search again
+        return _advanced_malloc(bytes, 1, heap, zero);
+    }
+
+    ++search;
+
+    /*  Failed to find a block. No matter what will have
+        to modify atleast one mapping.
+    */
+
+    char expected = MY_MALLOC_LOCK_FREE;
+    if (atomic_compare_exchange_strong(&heap->is_free, &expected, MY_MALLOC_LOCK_INSUSE))
+    {
+        void* res = _heap_grow(bytes, heap, zero, NULL);
+
+        atomic_store(&heap->is_free, MY_MALLOC_LOCK_FREE);
+
+        return res;
+    }
+
+    atomic_fetch_add_explicit(&heap->fails, 1, memory_order_relaxed);
+    _wait_long();
+
+    return _advanced_malloc(bytes, search, heap, zero);
+}
+
+static void*  _malloc_home(size_t bytes, _heap* heap, char zero)
+{
+    // allocate bytes from the calling thread's home
+    // block in heap, making a new home if none has
+    // room
+    // return pointer to allocated space
+
+    // Assume: bytes is rounded, small and heap is the
+    //         calling thread's arena
+
+    /*  Other threads only take a home to free into
+        it, so the owner waits on it instead of
+        looking for another block.
+    */
+
+    for (;;)
+    {
+        _block* block = _block_get_home(bytes, heap);
+
+        if (block)
+        {
+            _block_lock(block);
+
+            if (_block_has_room(bytes, block))
+            {
+                void* res = _block_alloc_unsafe(bytes, block, zero);
+                _block_lock_free(block);
+
+                return res;
+            }
+
+            // room was taken from outside the home path
+            _block_lock_free(block);
+
+            continue;
+        }
+
+        if (G_vars.coalesce && _heap_coalesce(bytes, heap))
+        {
+            // merging made room, maybe in a block of ours
+            continue;
+        }
+
+        char expected = MY_MALLOC_LOCK_FREE;
+        if (atomic_compare_exchange_strong(&heap->is_free, &expected, MY_MALLOC_LOCK_INSUSE))
+        {
+            // owned before other threads can see it
+
+            void* res = _heap_grow(bytes, heap, zero, &G_token);
+
+            if (res)
+            {
+                _block_home_set(MY_MALLOC_GET_AVAILABILITY((char*)res - MY_MALLOC_ALLOC_META));
+            }
+
+            atomic_store(&heap->is_free, MY_MALLOC_LOCK_FREE);
+
+            return res;
+        }
+
+        atomic_fetch_add_explicit(&heap->fails, 1, memory_order_relaxed);
+        _wait_long();
+    }
+}
+
+static void*  _malloc(size_t bytes, _heap* heap, char zero)
+{
+    // allocate bytes somewhere on heap
+    // zero the allocation if indicated
+    // return pointer to allocated space
+
+    if (bytes >= G_vars.large_sz)
+    {
+        // fresh from mmap, already zero
+        return _large_alloc(bytes, heap, 0);
+    }
+
+    bytes = MY_MALLOC_NODE_SZ(bytes);
+
+    if (G_vars.segregate && bytes <= MY_MALLOC_SMALL_MAX && heap == G_arena)
+    {
+        return _malloc_home(bytes, heap, zero);
+    }
+
+    void* block = _block_fit_get(bytes, heap);
+
+    if (block)
+    {
+        if (_block_acquire(bytes, block))
+        {
+            void* res = _block_alloc_unsafe(bytes, block, zero);
+            _block_lock_free(block);
+
+            return res;
+        }
+
+        if (G_vars.profile)
+        {
+            // lost the block to another thread
+
+            uint64_t start = _prof_now();
+            void* res = _advanced_malloc(bytes, 0, heap, zero);
+            _prof_add(MY_MALLOC_LAT_ACQUIRE, start);
+
+            return res;
+        }
+    }
+
+    return _advanced_malloc(bytes, 0, heap, zero);
+}
+
+static void   _free(void* ptr)
+{
+    // set an allocation to be freed
+
+    void* alloc_meta = (char*)ptr - MY_MALLOC_ALLOC_META;
+    void* block = MY_MALLOC_GET_AVAILABILITY(alloc_meta);
+
+    if (((_block*)block)->flags & MY_MALLOC_BLOCK_LARGE)
+    {
+        _large_free(block);
+
+        return;
+    }
+
+    _block* block_ptr = block;
+    char expected = MY_MALLOC_LOCK_FREE;
+
+    if (!atomic_compare_exchange_strong(&block_ptr->is_free, &expected, MY_MALLOC_LOCK_INSUSE))
+    {
+        // left for whoever holds the block
+
+        _block_defer(block, ptr);
+
+        // the holder may have let go before ptr was on
+        expected = MY_MALLOC_LOCK_FREE;
+        if (atomic_compare_exchange_strong(&block_ptr->is_free, &expected, MY_MALLOC_LOCK_INSUSE))
+        {
+            _block_lock_free(block);
+        }
+
+        G_recent = alloc_meta;
+        G_recent_block = block;
+
+        return;
+    }
+
+    _block_drain(block);
+
+    if (G_vars.trim_sz && MY_MALLOC_GET_SIZE(alloc_meta) >= G_vars.trim_sz)
+    {
+        _mem_trim(ptr, MY_MALLOC_GET_SIZE(alloc_meta));
+    }
+
+    _block_count(block, MY_MALLOC_GET_SIZE(alloc_meta), 0);
+    MY_MALLOC_SET_FREE(alloc_meta);
+    _index_mark(block, alloc_meta, 0);
+
+    if (!_block_merge_later(block, alloc_meta))
+    {
+        _block_update_meta(block);
+    }
+
+    _block_lock_free(block);
+
+    G_recent = alloc_meta;
+    G_recent_block = block;
+}
+
+static void*  _aligned_alloc(size_t align, size_t bytes, _heap* heap)
+{
+    // allocate bytes on heap aligned to align
+    // return start of allocation, or null if align
+    // is not a power of 2 of atmost a page
+
+    size_t page = sysconf(_SC_PAGESIZE);
+    if (!align || align & (align - 1) || align > page)
+    {
+        return NULL;
+    }
+
+    if (align <= MY_MALLOC_ALIGN)
+    {
+        return _malloc(bytes, heap, 0);
+    }
+
+    if (bytes > SIZE_MAX - align - MY_MALLOC_ALLOC_META - page)
+    {
+        return NULL;
+    }
+
+    if (bytes + align + MY_MALLOC_ALLOC_META >= G_vars.large_sz)
+    {
+        return _large_alloc(bytes, heap, align);
+    }
+
+    /*  Room is taken for a whole allocation meta data
+        in front of the aligned start. What is in front
+        is made into a free space of its own.
+
+        (sz,used) ->
+        becomes
+        (gap - META,free) -> (sz - gap,used) ->
+    */
+
+    char* ptr = _malloc(bytes + align + MY_MALLOC_ALLOC_META, heap, 0);
+    if (!ptr || !((uintptr_t)ptr & (align - 1)))
+    {
+        return ptr;
+    }
+
+    char* res = (char*)MY_MALLOC_ROUND((uintptr_t)ptr + MY_MALLOC_ALLOC_META, align);
+    size_t gap = res - ptr;
+
+    void* alloc_meta = ptr - MY_MALLOC_ALLOC_META;
+    void* block = MY_MALLOC_GET_AVAILABILITY(alloc_meta);
+    size_t sz = MY_MALLOC_GET_SIZE(alloc_meta);
+
+    _block_lock(block);
+
+    void* res_meta = res - MY_MALLOC_ALLOC_META;
+    MY_MALLOC_SET_INUSE(res_meta, block);
+    MY_MALLOC_SET_SIZE(res_meta, sz - gap);
+    _index_mark(block, res_meta, 1);
+    _block_count(block, sz, sz - gap);
+
+    MY_MALLOC_SET_FREE(alloc_meta);
+    MY_MALLOC_SET_SIZE(alloc_meta, gap - MY_MALLOC_ALLOC_META);
+    _index_mark(block, alloc_meta, 0);
+
+    _block_update_meta(block);
+
+    _block_lock_free(block);
+
+    return res;
+}
+
+static void   _guard_lock()
+{
+    // wait for sole access to the guard slots
+
+    char expected = MY_MALLOC_LOCK_FREE;
+    while (!atomic_compare_exchange_strong(&G_guard.is_free, &expected, MY_MALLOC_LOCK_INSUSE))
+    {
+        expected = MY_MALLOC_LOCK_FREE;
+        _wait_short();
+    }
+}
+
+static int    _guard_owns(void* ptr)
+{
+    // whether ptr is in a guard slot
+    // return 1 if yes, 0 otherwise
+
+    return (uintptr_t)ptr - (uintptr_t)G_guard.start < atomic_load_explicit(&G_guard.len, memory_order_relaxed);
+}
+
+static void   _guard_write(const char* str, uintptr_t num)
+{
+    // write str then num in hex to stderr, using
+    // only what is safe in a signal handler
+
+    char buf[2 + (2 * sizeof(num))];
+    size_t i = sizeof(buf);
+
+    do
+    {
+        buf[--i] = "0123456789abcdef"[num & 0xf];
+        num >>= 4;
+    } while (num);
+
+    buf[--i] = 'x';
+    buf[--i] = '0';
+
+    if (write(STDERR_FILENO, str, strlen(str)) < 0 || write(STDERR_FILENO, buf + i, sizeof(buf) - i) < 0)
+    {
+        return;
+    }
+}
+
+static void   _guard_report(const char* what, void* addr, size_t slot)
+{
+    // report a bad access to addr involving slot
+
+    char* page = G_guard.start + (((2 * slot) + 1) * G_guard.page);
+
+    _guard_write(what, (uintptr_t)addr);
+    _guard_write(", allocation of ", G_guard.slot[slot].bytes);
+    _guard_write(" bytes at ", (uintptr_t)(page + G_guard.page - G_guard.slot[slot].sz));
+
+    if (write(STDERR_FILENO, "\n", 1) < 0)
+    {
+        return;
+    }
+}
+
+static void   _guard_segv(int sig, siginfo_t* info, void* context)
+{
+    // report faults inside of the guard slots, pass
+    // every other fault on
+
+    char* addr = info->si_addr;
+
+    if (!_guard_owns(addr))
+    {
+        if ((G_guard_old.sa_flags & SA_SIGINFO) && G_guard_old.sa_sigaction)
+        {
+            G_guard_old.sa_sigaction(sig, info, context);
+
+            return;
+        }
+
+        if (G_guard_old.sa_handler != SIG_DFL && G_guard_old.sa_handler != SIG_IGN)
+        {
+            G_guard_old.sa_handler(sig);
+
+            return;
+        }
+    }
+    else
+    {
+        /*  Odd pages are slots, even pages guard them.
+
+            G S G S G ... S G
+            0 1 2 3 4       2 * slots
+        */
+
+        size_t page = (addr - G_guard.start) / G_guard.page;
+
+        if (page % 2)
+        {
+            size_t slot = page / 2;
+
+            _guard_report
+            (
+                G_guard.slot[slot].state == MY_MALLOC_GUARD_FREED ? "my_malloc: use after free at " : "my_malloc: invalid access at ",
+                addr,
+                slot
+            );
+        }
+        else
+        {
+            // blame the closer slot, when it is in use
+
+            size_t next = page / 2;
+            int near_prev = (size_t)(addr - G_guard.start) % G_guard.page < G_guard.page / 2;
+            int prev_used = next && G_guard.slot[next - 1].state == MY_MALLOC_GUARD_INUSE;
+            int next_used = next != G_guard.slots && G_guard.slot[next].state == MY_MALLOC_GUARD_INUSE;
+
+            if (prev_used && (near_prev || !next_used))
+            {
+                _guard_report("my_malloc: buffer overflow at ", addr, next - 1);
+            }
+            else if (next_used)
+            {
+                _guard_report("my_malloc: buffer underflow at ", addr, next);
+            }
+        }
+    }
+
+    // fault again with the handler from before
+    sigaction(SIGSEGV, &G_guard_old, NULL);
+}
+
+static int    _guard_init()
+{
+    // map the slots and their guard pages
+    // return 1 if successful
+
+    // Assume: guard slots are held
+
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t slots = G_vars.guard_slots;
+    size_t len = ((2 * slots) + 1) * page;
+
+    char* start = mmap(NULL, len, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (start == (void*)-1)
+    {
+        return 0;
+    }
+
+    struct MallocGuardSlot* slot = _mem_get(MY_MALLOC_ROUND(slots * sizeof(*slot), page));
+    if (!slot)
+    {
+        munmap(start, len);
+
+        return 0;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = _guard_segv;
+    action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+    sigemptyset(&action.sa_mask);
+
+    if (sigaction(SIGSEGV, &action, &G_guard_old))
+    {
+        munmap(slot, MY_MALLOC_ROUND(slots * sizeof(*slot), page));
+        munmap(start, len);
+
+        return 0;
+    }
+
+    G_guard.page  = page;
+    G_guard.slots = slots;
+    G_guard.slot  = slot;
+    G_guard.start = start;
+
+    // len last, it is what _guard_owns checks against
+    atomic_store(&G_guard.len, len);
+
+    return 1;
+}
+
+static void*  _guard_alloc(size_t bytes)
+{
+    // allocate bytes at the end of a free slot
+    // return NULL if no slot could be used
+
+    if (bytes > (size_t)sysconf(_SC_PAGESIZE) - MY_MALLOC_ALLOC_META - MY_MALLOC_ALIGN)
+    {
+        return NULL;
+    }
+
+    _guard_lock();
+
+    if (!G_guard.start && !_guard_init())
+    {
+        atomic_store(&G_guard.is_free, MY_MALLOC_LOCK_FREE);
+
+        return NULL;
+    }
+
+    /*  Look for a free slot starting after the last one
+        taken, so freed slots stay inaccessible for as
+        long as possible.
+    */
+
+    size_t slot = G_guard.next;
+    for (size_t i = 0; i != G_guard.slots && G_guard.slot[slot].state == MY_MALLOC_GUARD_INUSE; ++i)
+    {
+        slot = (slot + 1) % G_guard.slots;
+    }
+
+    char* page = G_guard.start + (((2 * slot) + 1) * G_guard.page);
+
+    if
+    (
+        G_guard.slot[slot].state == MY_MALLOC_GUARD_INUSE
+        ||
+        mprotect(page, G_guard.page, PROT_READ | PROT_WRITE)
+    )
+    {
+        atomic_store(&G_guard.is_free, MY_MALLOC_LOCK_FREE);
+
+        return NULL;
+    }
+
+    /*  Against the end of the page to catch overflows,
+        which are more common than underflows. Sized
+        like a node, so aligned like any allocation,
+        which leaves overflows of less than
+        MY_MALLOC_ALIGN bytes uncaught.
+    */
+
+    size_t sz = MY_MALLOC_NODE_SZ(bytes);
+    char* res = page + G_guard.page - sz;
+
+    MY_MALLOC_SET_SIZE(res - MY_MALLOC_ALLOC_META, sz);
+    MY_MALLOC_SET_INUSE(res - MY_MALLOC_ALLOC_META, &G_guard);
+
+    G_guard.slot[slot].bytes = bytes;
+    G_guard.slot[slot].sz    = sz;
+    G_guard.slot[slot].state = MY_MALLOC_GUARD_INUSE;
+    G_guard.next = (slot + 1) % G_guard.slots;
+
+    atomic_store(&G_guard.is_free, MY_MALLOC_LOCK_FREE);
+
+    return res;
+}
+
+static void   _guard_free(void* ptr)
+{
+    // make the slot ptr is in inaccessible
+
+    size_t slot = ((char*)ptr - G_guard.start) / G_guard.page / 2;
+    char* page = G_guard.start + (((2 * slot) + 1) * G_guard.page);
+
+    _guard_lock();
+
+    if (G_guard.slot[slot].state != MY_MALLOC_GUARD_INUSE)
+    {
+        _guard_report("my_malloc: double free at ", ptr, slot);
+        abort();
+    }
+
+    G_guard.slot[slot].state = MY_MALLOC_GUARD_FREED;
+
+    // zero for when the slot is next used
+    madvise(page, G_guard.page, MADV_DONTNEED);
+    mprotect(page, G_guard.page, PROT_NONE);
+
+    atomic_store(&G_guard.is_free, MY_MALLOC_LOCK_FREE);
+}
+
+static void*  _my_malloc(size_t bytes);
+static void   _my_free(void* ptr);
+
+static void*  _realloc(void* ptr, size_t size, _heap* heap)
+{
+    // reallocate previously allocated ptr to
+    // a new size, moving it onto heap if it
+    // does not fit in place
+    // if heap is NULL move it with my_malloc
+    // return pointer to new allocation
+
+    if (!ptr)
+    {
+        return heap ? _malloc(size, heap, 0) : _my_malloc(size);
+    }
+
+    if (size > SIZE_MAX - MY_MALLOC_ALIGN)
+    {
+        return NULL;
+    }
+
+    void* alloc_meta = (char*)ptr - MY_MALLOC_ALLOC_META;
+
+    if (_guard_owns(ptr))
+    {
+        // never grown in place, the page after is a guard
+
+        void* new_ptr = _my_malloc(size);
+        if (new_ptr)
+        {
+            size_t curr_sz = MY_MALLOC_GET_SIZE(alloc_meta);
+            memcpy(new_ptr, ptr, curr_sz < size ? curr_sz : size);
+            _guard_free(ptr);
+        }
+
+        return new_ptr;
+    }
+
+    void* block = MY_MALLOC_GET_AVAILABILITY(alloc_meta);
+    char* end = (char*)block + ((_block*)block)->sz;
+
+    _block_lock(block);
+
+    if (((_block*)block)->pending)
+    {
+        // the free space after may be split in nodes
+        _block_update_meta(block);
+    }
+
+    /*  In place there is the allocation itself and
+        the node after it if that is free.
+
+        (curr_sz,used) -> (next_sz,free) ->
+        becomes
+        (size,used) -> (avail - size - META,free) ->
+    */
+
+    size_t curr_sz = MY_MALLOC_GET_SIZE(alloc_meta);
+    size_t avail = curr_sz;
+
+    void* next = MY_MALLOC_NEXT(alloc_meta);
+    int next_free = (char*)next < end && !MY_MALLOC_GET_AVAILABILITY(next);
+    if (next_free)
+    {
+        avail += MY_MALLOC_GET_SIZE(next) + MY_MALLOC_ALLOC_META;
+    }
+
+    if (size <= avail)
+    {
+        size = MY_MALLOC_NODE_SZ(size);
+
+        if (next_free)
+        {
+            _index_unmark(block, next);
+        }
+
+        if (avail - size >= MY_MALLOC_ALLOC_META)
+        {
+            MY_MALLOC_SET_SIZE(alloc_meta, size);
+            _block_count(block, curr_sz, size);
+
+            void* next_new = MY_MALLOC_NEXT(alloc_meta);
+            MY_MALLOC_SET_FREE(next_new);
+            MY_MALLOC_SET_SIZE(next_new, avail - size - MY_MALLOC_ALLOC_META);
+            _index_mark(block, next_new, 0);
+
+            _block_dirty(block, (char*)next_new + MY_MALLOC_ALLOC_META);
+        }
+        else
+        {
+            // no room for meta data, keep the slack
+            MY_MALLOC_SET_SIZE(alloc_meta, avail);
+            _block_count(block, curr_sz, avail);
+
+            _block_dirty(block, MY_MALLOC_NEXT(alloc_meta));
+        }
+
+        _block_update_meta(block);
+
+        _block_lock_free(block);
+
+        return ptr;
+    }
+
+    _block_lock_free(block);
+
+    // new allocation and copy
+    void* new_ptr = heap ? _malloc(size, heap, 0) : _my_malloc(size);
+    if (new_ptr)
+    {
+        memcpy(new_ptr, ptr, curr_sz);
+
+        if (heap)
+        {
+            _free(ptr);
+        }
+        else
+        {
+            _my_free(ptr);
+        }
+    }
+
+    return new_ptr;
+}
+
+static void   _block_stats(void* block, struct MallocStats* stats)
+{
+    // add the used and free bytes of block to stats
+
+    _block* block_ptr = block;
+
+    _block_lock(block);
+
+    stats->free_max    += block_ptr->max_free;
+    stats->block_fails += atomic_load_explicit(&block_ptr->fails, memory_order_relaxed);
+    stats->block_spins += atomic_load_explicit(&block_ptr->spins, memory_order_relaxed);
+    stats->block_deferred += atomic_load_explicit(&block_ptr->deferred, memory_order_relaxed);
+    stats->block_pending  += block_ptr->pending;
+
+    size_t sz;
+    int in_use;
+    for (void* curr = _block_next_node(block, NULL, &sz, &in_use); curr; curr = _block_next_node(block, curr, &sz, &in_use))
+    {
+        if (in_use)
+        {
+            stats->in_use += sz;
+        }
+        else
+        {
+            stats->free += sz;
+        }
+    }
+
+    _block_lock_free(block);
+}
+
+static void   _heap_stats(_heap* heap, struct MallocStats* stats)
+{
+    // add the statistics of heap to stats
+
+    _heap_lock(heap);
+
+    stats->mapped     += atomic_load_explicit(&heap->mapped, memory_order_relaxed);
+    stats->num_mmap   += atomic_load_explicit(&heap->num_mmap, memory_order_relaxed);
+    stats->num_munmap += atomic_load_explicit(&heap->num_munmap, memory_order_relaxed);
+    stats->heap_fails += atomic_load_explicit(&heap->fails, memory_order_relaxed);
+    stats->purged     += atomic_load_explicit(&heap->purged, memory_order_relaxed);
+
+    for (_mapping* mapping = heap->start_map; mapping; mapping = mapping->next)
+    {
+        for (void* block = mapping->start_block; block; block = ((_block*)block)->next)
+        {
+            _block_stats(block, stats);
+        }
+    }
+
+    stats->in_use += atomic_load_explicit(&heap->large, memory_order_relaxed);
+
+    atomic_store(&heap->is_free, MY_MALLOC_LOCK_FREE);
+}
+
+static size_t _heap_hot_blocks(_heap* heap, struct MallocHotBlock* hot, size_t num, size_t found)
+{
+    // insert the blocks of heap into the found most
+    // contended blocks in hot, keeping atmost num
+    // return the number now in hot
+
+    _heap_lock(heap);
+
+    for (_mapping* mapping = heap->start_map; mapping; mapping = mapping->next)
+    {
+        for (_block* block = mapping->start_block; block; block = block->next)
+        {
+            struct MallocHotBlock curr =
+            {
+                .block = block,
+                .sz    = block->sz,
+                .fails = atomic_load_explicit(&block->fails, memory_order_relaxed),
+                .spins = atomic_load_explicit(&block->spins, memory_order_relaxed)
+            };
+
+            if (!curr.fails && !curr.spins)
+            {
+                continue;
+            }
+
+            // insertion sort, dropping the least contended
+            size_t i = found < num ? found++ : num;
+            for (; i && hot[i - 1].fails + hot[i - 1].spins < curr.fails + curr.spins; --i)
+            {
+                if (i < num)
+                {
+                    hot[i] = hot[i - 1];
+                }
+            }
+
+            if (i < num)
+            {
+                hot[i] = curr;
+            }
+        }
+    }
+
+    atomic_store(&heap->is_free, MY_MALLOC_LOCK_FREE);
+
+    return found;
+}
+
+static int    _heap_walk(_heap* heap, my_malloc_walk_fn fn, void* ctx)
+{
+    // call fn on every mapping, block and allocation
+    // of heap
+    // return what fn returned to stop, otherwise 0
+
+    /*  Nodes are read the way allocating reads them,
+        from the index if the block has one, each
+        block held while its allocations are walked.
+    */
+
+    int res = 0;
+
+    _heap_lock(heap);
+
+    _mapping* lists[] = { heap->start_map, heap->large_map };
+
+    for (size_t i = 0; !res && i != sizeof(lists) / sizeof(lists[0]); ++i)
+    {
+        for (_mapping* mapping = lists[i]; !res && mapping; mapping = mapping->next)
+        {
+            struct MallocWalkEntry entry =
+            {
+                .kind   = MY_MALLOC_WALK_MAPPING,
+                .addr   = mapping->start,
+                .sz     = (char*)mapping->end - (char*)mapping->start,
+                .in_use = 1
+            };
+
+            res = fn(&entry, ctx);
+
+            for (_block* block = mapping->start_block; !res && block; block = block->next)
+            {
+                entry.kind = MY_MALLOC_WALK_BLOCK;
+                entry.addr = block;
+                entry.sz   = block->sz;
+
+                res = fn(&entry, ctx);
+                if (res)
+                {
+                    break;
+                }
+
+                _block_lock(block);
+
+                size_t sz;
+                int in_use;
+                for (void* curr = _block_next_node(block, NULL, &sz, &in_use); !res && curr; curr = _block_next_node(block, curr, &sz, &in_use))
+                {
+                    entry.kind   = MY_MALLOC_WALK_ALLOC;
+                    entry.addr   = (char*)curr + MY_MALLOC_ALLOC_META;
+                    entry.sz     = sz;
+                    entry.in_use = in_use;
+
+                    res = fn(&entry, ctx);
+                }
+
+                _block_lock_free(block);
+
+                entry.in_use = 1;
+            }
+        }
+    }
+
+    atomic_store(&heap->is_free, MY_MALLOC_LOCK_FREE);
+
+    return res;
+}
+
+/*  What my_heap_dump has seen so far.
+*/
+struct MallocDump
+{
+    int fd;
+
+    /*  Block being walked.
+    */
+    void*  block;
+    size_t sz;
+    size_t used;
+    size_t free;
+    size_t hole;
+
+    /*  Over every block walked.
+    */
+    size_t total_sz;
+    size_t total_used;
+    size_t total_free;
+    size_t total_hole;
+
+    /*  Holes by highest bit set in their size.
+    */
+    size_t holes[MY_MALLOC_NUM_BITS];
+};
+
+static double _dump_frag(size_t free, size_t hole)
+{
+    // share of free bytes not in the largest hole
+
+    return free ? 1 - ((double)hole / free) : 0;
+}
+
+static void   _dump_block(struct MallocDump* dump)
+{
+    // write the line of the block being walked
+
+    if (!dump->block)
+    {
+        return;
+    }
+
+    dprintf
+    (
+        dump->fd,
+        "%18p %10zu %10zu %10zu %10zu %6.3f\n",
+        dump->block,
+        dump->sz,
+        dump->used,
+        dump->free,
+        dump->hole,
+        _dump_frag(dump->free, dump->hole)
+    );
+
+    dump->total_sz   += dump->sz;
+    dump->total_used += dump->used;
+    dump->total_free += dump->free;
+    if (dump->hole > dump->total_hole)
+    {
+        dump->total_hole = dump->hole;
+    }
+
+    dump->block = NULL;
+}
+
+static int    _dump_entry(const struct MallocWalkEntry* entry, void* ctx)
+{
+    // add entry to the dump ctx
+
+    struct MallocDump* dump = ctx;
+
+    if (entry->kind == MY_MALLOC_WALK_BLOCK)
+    {
+        _dump_block(dump);
+
+        dump->block = entry->addr;
+        dump->sz    = entry->sz;
+        dump->used  = 0;
+        dump->free  = 0;
+        dump->hole  = 0;
+    }
+    else if (entry->kind == MY_MALLOC_WALK_ALLOC)
+    {
+        if (entry->in_use)
+        {
+            dump->used += entry->sz;
+        }
+        else if (entry->sz)
+        {
+            dump->free += entry->sz;
+            if (entry->sz > dump->hole)
+            {
+                dump->hole = entry->sz;
+            }
+
+            ++dump->holes[MY_MALLOC_NUM_BITS - 1 - MY_MALLOC_CLZ(entry->sz)];
+        }
+    }
+
+    return 0;
+}
+
+static void   _transfer_lock(_transfer* transfer)
+{
+    // wait for sole access to transfer
+
+    char expected = MY_MALLOC_LOCK_FREE;
+    while (!atomic_compare_exchange_strong(&transfer->is_free, &expected, MY_MALLOC_LOCK_INSUSE))
+    {
+        expected = MY_MALLOC_LOCK_FREE;
+        _wait_short();
+    }
+}
+
+static int    _transfer_put(size_t cls)
+{
+    // move a batch off of the calling thread's cache
+    // for cls onto the transfer cache
+    // return 1 if moved, 0 otherwise
+
+    // segregated caches only hold what the thread
+    // owns, which no other thread may be handed
+
+    size_t batch = G_vars.cache_sz / 2;
+    if (G_vars.segregate || !G_vars.transfer_sz || !batch || my_malloc_tcache.count[cls] < batch)
+    {
+        return 0;
+    }
+
+    // cut the batch off before taking the lock
+
+    void* first = my_malloc_tcache.head[cls];
+    void* last = first;
+    for (size_t i = 1; i != batch; ++i)
+    {
+        last = *(void**)last;
+    }
+    void* rest = *(void**)last;
+
+    _transfer* transfer = &G_transfer[cls];
+    _transfer_lock(transfer);
+
+    if (transfer->num >= G_vars.transfer_sz)
+    {
+        atomic_store(&transfer->is_free, MY_MALLOC_LOCK_FREE);
+
+        return 0;
+    }
+
+    *(void**)last = NULL;
+    transfer->batch[transfer->num] = first;
+    transfer->count[transfer->num] = batch;
+    ++transfer->num;
+    atomic_fetch_add_explicit(&transfer->total, batch, memory_order_relaxed);
+    transfer->touched = atomic_load_explicit(&G_decay_now, memory_order_relaxed);
+
+    atomic_store(&transfer->is_free, MY_MALLOC_LOCK_FREE);
+
+    my_malloc_tcache.head[cls] = rest;
+    my_malloc_tcache.count[cls] -= batch;
+
+    return 1;
+}
+
+static void   _tcache_flush(void* unused)
+{
+    // give every allocation in the calling thread's
+    // cache to the transfer cache, or back to its
+    // block once that is full, then give up the
+    // blocks it owns
+
+    for (size_t cls = 0; cls != MY_MALLOC_NUM_CLASSES; ++cls)
+    {
+        while (_transfer_put(cls));
+
+        while (my_malloc_tcache.head[cls])
+        {
+            void* ptr = my_malloc_tcache.head[cls];
+            my_malloc_tcache.head[cls] = *(void**)ptr;
+
+            _free(ptr);
+        }
+
+        my_malloc_tcache.count[cls] = 0;
+    }
+
+    _block_home_release();
+
+    G_tcache_registered = 0;
+}
+
+static void   _tcache_key_create()
+{
+    // create the key used to flush caches on
+    // thread exit
+
+    pthread_key_create(&G_tcache_key, _tcache_flush);
+}
+
+static void   _tcache_register()
+{
+    // have the calling thread's cache flushed
+    // when it exits
+
+    if (!G_tcache_registered)
+    {
+        // value only needs to be non NULL for the
+        // destructor to be called
+
+        pthread_once(&G_tcache_once, _tcache_key_create);
+        pthread_setspecific(G_tcache_key, &my_malloc_tcache);
+
+        G_tcache_registered = 1;
+    }
+}
+
+static void   _tcache_push(void* ptr, size_t cls)
+{
+    // put ptr onto the calling thread's cache
+
+    _tcache_register();
+
+    *(void**)ptr = my_malloc_tcache.head[cls];
+    my_malloc_tcache.head[cls] = ptr;
+    ++my_malloc_tcache.count[cls];
+}
+
+static void*  _transfer_get(size_t cls)
+{
+    // move a batch from the transfer cache onto the
+    // calling thread's cache for cls, which is empty
+    // return one allocation of the batch, or null
+    // if there is no batch
+
+    if (G_vars.segregate)
+    {
+        // batches may hold objects of blocks other
+        // threads own
+        return NULL;
+    }
+
+    _transfer* transfer = &G_transfer[cls];
+    _transfer_lock(transfer);
+
+    if (!transfer->num)
+    {
+        atomic_store(&transfer->is_free, MY_MALLOC_LOCK_FREE);
+
+        return NULL;
+    }
+
+    --transfer->num;
+    void* res = transfer->batch[transfer->num];
+    size_t count = transfer->count[transfer->num];
+    atomic_fetch_sub_explicit(&transfer->total, count, memory_order_relaxed);
+    transfer->touched = atomic_load_explicit(&G_decay_now, memory_order_relaxed);
+
+    atomic_store(&transfer->is_free, MY_MALLOC_LOCK_FREE);
+
+    _tcache_register();
+
+    my_malloc_tcache.head[cls] = *(void**)res;
+    my_malloc_tcache.count[cls] = count - 1;
+
+    return res;
+}
+
+static void   _transfer_stats(struct MallocStats* stats)
+{
+    // add the bytes in the transfer cache to stats
+
+    for (size_t cls = 0; cls != MY_MALLOC_NUM_CLASSES; ++cls)
+    {
+        stats->transfer += atomic_load_explicit(&G_transfer[cls].total, memory_order_relaxed) * G_class_sz[cls];
+    }
+}
+
+static uint32_t _decay_clock()
+{
+    // milliseconds since some point, wrapping
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint32_t)((now.tv_sec * 1000) + (now.tv_nsec / 1000000));
+}
+
+static void   _block_decay(void* block, _heap* heap, uint32_t decay)
+{
+    // give back the pages of the free space of
+    // block if idle for decay milliseconds
+
+    _block* block_ptr = block;
+    char expected = MY_MALLOC_LOCK_FREE;
+
+    if (block_ptr->flags & MY_MALLOC_BLOCK_PURGED || !atomic_compare_exchange_strong(&block_ptr->is_free, &expected, MY_MALLOC_LOCK_INSUSE))
+    {
+        return;
+    }
+
+    _block_drain(block);
+
+    if (atomic_load_explicit(&G_decay_now, memory_order_relaxed) - block_ptr->touched >= decay)
+    {
+        size_t purged = 0;
+
+        size_t sz;
+        for (void* curr = _block_next_free(block, NULL, &sz); curr; curr = _block_next_free(block, curr, &sz))
+        {
+            purged += _mem_trim((char*)curr + MY_MALLOC_ALLOC_META, sz);
+        }
+
+        block_ptr->flags |= MY_MALLOC_BLOCK_PURGED;
+        atomic_fetch_add_explicit(&heap->purged, purged, memory_order_relaxed);
+    }
+
+    _block_lock_free(block);
+}
+
+static void   _transfer_decay(size_t cls, uint32_t decay)
+{
+    // free every batch of the transfer cache
+    // for cls if idle for decay milliseconds
+
+    _transfer* transfer = &G_transfer[cls];
+    _transfer_lock(transfer);
+
+    void* batch[MY_MALLOC_TRANSFER_SLOTS];
+    size_t num = 0;
+
+    if (atomic_load_explicit(&G_decay_now, memory_order_relaxed) - transfer->touched >= decay)
+    {
+        num = transfer->num;
+        memcpy(batch, transfer->batch, num * sizeof(void*));
+        transfer->num = 0;
+        atomic_store_explicit(&transfer->total, 0, memory_order_relaxed);
+    }
+
+    atomic_store(&transfer->is_free, MY_MALLOC_LOCK_FREE);
+
+    for (size_t i = 0; i != num; ++i)
+    {
+        while (batch[i])
+        {
+            void* ptr = batch[i];
+            batch[i] = *(void**)ptr;
+
+            _free(ptr);
+        }
+    }
+}
+
+static void   _tcache_decay()
+{
+    // free what the calling thread's cache held
+    // since it last did this, decay milliseconds ago
+
+    uint32_t now = atomic_load_explicit(&G_decay_now, memory_order_relaxed);
+    if (now - G_tcache_trimmed < G_vars.decay_ms)
+    {
+        return;
+    }
+
+    G_tcache_trimmed = now;
+
+    for (size_t cls = 0; cls != MY_MALLOC_NUM_CLASSES; ++cls)
+    {
+        // the last low allocations were never taken
+
+        size_t count = my_malloc_tcache.count[cls];
+        size_t keep = count - (my_malloc_tcache.low[cls] < count ? my_malloc_tcache.low[cls] : count);
+
+        my_malloc_tcache.low[cls] = keep;
+
+        if (keep == count)
+        {
+            continue;
+        }
+
+        void** link = &my_malloc_tcache.head[cls];
+        for (size_t i = 0; i != keep; ++i)
+        {
+            link = *link;
+        }
+
+        void* ptr = *link;
+        *link = NULL;
+        my_malloc_tcache.count[cls] = keep;
+
+        while (ptr)
+        {
+            void* next = *(void**)ptr;
+            _free(ptr);
+            ptr = next;
+        }
+    }
+}
+
+static void*  _decay_run(void* unused)
+{
+    // periodically give back what has been idle
+
+    /*  Thread caches belong to their threads, which
+        trim them, see _tcache_decay.
+    */
+
+    for (;;)
+    {
+        // while disabled, check back every second
+
+        size_t decay = G_vars.decay_ms;
+        size_t wait = !decay ? 1000 : decay / 2 ? decay / 2 : 1;
+
+        struct timespec sleep_for =
+        {
+            wait / 1000,
+            (wait % 1000) * 1000000
+        };
+        nanosleep(&sleep_for, NULL);
+
+        atomic_store_explicit(&G_decay_now, _decay_clock(), memory_order_relaxed);
+
+        if (!decay)
+        {
+            continue;
+        }
+
+        for (size_t i = 0; i != MY_MALLOC_MAX_ARENAS; ++i)
+        {
+            _heap* heap = &G_arenas[i];
+
+            for (_mapping* mapping = heap->start_map; mapping; mapping = mapping->next)
+            {
+                for (void* block = mapping->start_block; block; block = ((_block*)block)->next)
+                {
+                    _block_decay(block, heap, decay);
+                }
+            }
+        }
+
+        for (size_t cls = 0; cls != MY_MALLOC_NUM_CLASSES; ++cls)
+        {
+            _transfer_decay(cls, decay);
+        }
+    }
+
+    return NULL;
+}
+
+static void   _decay_start()
+{
+    // start the decay thread
+
+    atomic_store_explicit(&G_decay_now, _decay_clock(), memory_order_relaxed);
+
+    pthread_t thread;
+    if (!pthread_create(&thread, NULL, _decay_run, NULL))
+    {
+        pthread_detach(thread);
+    }
+}
+
+static void   _publish_name(char* name, size_t len, long pid)
+{
+    // write the name of the segment of pid to name
+
+    snprintf(name, len, MY_MALLOC_SHARED_NAME, pid);
+}
+
+static struct MallocShared* _publish_open()
+{
+    // make the shared memory segment of the calling
+    // process
+    // return it, NULL on failure
+
+    char name[64];
+    _publish_name(name, sizeof(name), (long)getpid());
+
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd == -1)
+    {
+        return NULL;
+    }
+
+    struct MallocShared* shared = MAP_FAILED;
+    if (!ftruncate(fd, sizeof(struct MallocShared)))
+    {
+        shared = mmap(NULL, sizeof(struct MallocShared), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    if (shared == MAP_FAILED)
+    {
+        shm_unlink(name);
+
+        return NULL;
+    }
+
+    // zero from ftruncate, so seq starts even
+
+    shared->version = MY_MALLOC_SHARED_VERSION;
+    shared->pid = (long)getpid();
+    shared->num_classes = MY_MALLOC_NUM_CLASSES;
+    memcpy(shared->class_sz, G_class_sz, sizeof(G_class_sz));
+
+    // readers take the segment as ready once magic is set
+    __atomic_store_n(&shared->magic, MY_MALLOC_SHARED_MAGIC, __ATOMIC_RELEASE);
+
+    return shared;
+}
+
+static void   _publish_stats(struct MallocStats* stats)
+{
+    // add the statistics of the heaps used by
+    // my_malloc to stats, without taking anything
+
+    /*  Only counters kept as memory is mapped and
+        allocations made are read, each on its own,
+        so they may not agree while allocating. The
+        mappings are walked like searching threads
+        do, never unmapped. The meta data of free
+        nodes is counted as free, as the nodes are
+        not read.
+    */
+
+    for (size_t i = 0; i != MY_MALLOC_MAX_ARENAS; ++i)
+    {
+        _heap* heap = &G_arenas[i];
+
+        stats->mapped     += atomic_load_explicit(&heap->mapped, memory_order_relaxed);
+        stats->num_mmap   += atomic_load_explicit(&heap->num_mmap, memory_order_relaxed);
+        stats->num_munmap += atomic_load_explicit(&heap->num_munmap, memory_order_relaxed);
+        stats->heap_fails += atomic_load_explicit(&heap->fails, memory_order_relaxed);
+        stats->purged     += atomic_load_explicit(&heap->purged, memory_order_relaxed);
+        stats->in_use     += atomic_load_explicit(&heap->large, memory_order_relaxed);
+
+        for (_mapping* mapping = heap->start_map; mapping; mapping = mapping->next)
+        {
+            for (_block* block = mapping->start_block; block; block = block->next)
+            {
+                size_t nodes = (char*)block + block->sz - MY_MALLOC_BLOCK_NODES(block);
+                size_t used = atomic_load_explicit(&block->used, memory_order_relaxed);
+                size_t meta = MY_MALLOC_ALLOC_META * atomic_load_explicit(&block->used_nodes, memory_order_relaxed);
+
+                stats->in_use         += used;
+                stats->free           += used + meta < nodes ? nodes - used - meta : 0;
+                stats->free_max       += block->max_free;
+                stats->block_fails    += atomic_load_explicit(&block->fails, memory_order_relaxed);
+                stats->block_spins    += atomic_load_explicit(&block->spins, memory_order_relaxed);
+                stats->block_deferred += atomic_load_explicit(&block->deferred, memory_order_relaxed);
+                stats->block_pending  += block->pending;
+            }
+        }
+    }
+
+    _transfer_stats(stats);
+}
+
+static void   _publish_write(struct MallocShared* shared)
+{
+    // write the statistics of the heaps used by
+    // my_malloc to shared
+
+    /*  Everything is gathered before taking the
+        seqlock, so readers only retry for a copy.
+    */
+
+    struct MallocStats stats = { 0 };
+    _publish_stats(&stats);
+
+    size_t requests[MY_MALLOC_NUM_CLASSES] = { 0 };
+    size_t transfer[MY_MALLOC_NUM_CLASSES] = { 0 };
+
+    for (size_t i = 0; i != MY_MALLOC_PROF_SIZES; ++i)
+    {
+        size_t sz = (i + 1) * MY_MALLOC_PROF_SIZE_STEP;
+        size_t cls = my_malloc_size_class(sz < MY_MALLOC_SMALL_MAX ? sz : MY_MALLOC_SMALL_MAX);
+
+        for (_profile* profile = atomic_load(&G_profiles); profile; profile = profile->next)
+        {
+            requests[cls] += profile->sizes[i];
+        }
+    }
+
+    for (size_t cls = 0; cls != MY_MALLOC_NUM_CLASSES; ++cls)
+    {
+        transfer[cls] = atomic_load_explicit(&G_transfer[cls].total, memory_order_relaxed);
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    // only this thread writes, so seq is read plainly
+
+    size_t seq = shared->seq;
+    __atomic_store_n(&shared->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    ++shared->updates;
+    shared->time_ns = ((size_t)now.tv_sec * 1000000000) + now.tv_nsec;
+    shared->stats = stats;
+    memcpy(shared->class_requests, requests, sizeof(requests));
+    memcpy(shared->class_transfer, transfer, sizeof(transfer));
+
+    __atomic_store_n(&shared->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+static void*  _publish_run(void* unused)
+{
+    // periodically write the statistics to shared
+    // memory
+
+    struct MallocShared* shared = _publish_open();
+    if (!shared)
+    {
+        return NULL;
+    }
+
+    atomic_store(&G_shared, shared);
+
+    for (;;)
+    {
+        // while disabled, check back every second
+
+        size_t publish = G_vars.publish_ms;
+        size_t wait = publish ? publish : 1000;
+
+        if (publish)
+        {
+            _publish_write(shared);
+        }
+
+        struct timespec sleep_for =
+        {
+            wait / 1000,
+            (wait % 1000) * 1000000
+        };
+        nanosleep(&sleep_for, NULL);
+    }
+
+    return NULL;
+}
+
+static void   _publish_fork()
+{
+    // forget the segment of the parent in a child
+    // made by fork, which has no publish thread,
+    // so setting publish again makes its own
+
+    struct MallocShared* shared = atomic_load(&G_shared);
+    if (shared)
+    {
+        munmap(shared, sizeof(struct MallocShared));
+    }
+    atomic_store(&G_shared, NULL);
+
+    static const pthread_once_t once = PTHREAD_ONCE_INIT;
+    G_publish_once = once;
+}
+
+static void   _publish_start()
+{
+    // start the publish thread
+
+    // a child made by fork keeps the handler
+    static int forks;
+    if (!forks)
+    {
+        forks = !pthread_atfork(NULL, NULL, _publish_fork);
+    }
+
+    pthread_t thread;
+    if (!pthread_create(&thread, NULL, _publish_run, NULL))
+    {
+        pthread_detach(thread);
+    }
+}
+
+__attribute__((destructor))
+static void   _publish_close()
+{
+    // remove the segment on exit
+
+    struct MallocShared* shared = atomic_load(&G_shared);
+
+    if (shared)
+    {
+        char name[64];
+        _publish_name(name, sizeof(name), shared->pid);
+
+        shm_unlink(name);
+    }
+}
+
+void* my_malloc_class(size_t cls)
+{
+    // allocate a whole size class
+
+    if (G_vars.decay_ms)
+    {
+        _tcache_decay();
+    }
+
+    void* res = _transfer_get(cls);
+    if (res)
+    {
+        return res;
+    }
+
+    return _malloc(G_class_sz[cls], _heap_arena(), 0);
+}
+
+static void*  _my_malloc(size_t bytes)
+{
+    // allocate bytes somewhere on the heap
+    // return pointer to allocated space
+
+    if (G_vars.guard_rate && ++G_guard_count >= G_vars.guard_rate)
+    {
+        G_guard_count = 0;
+
+        void* res = _guard_alloc(bytes);
+        if (res)
+        {
+            return res;
+        }
+    }
+
+    if (bytes <= MY_MALLOC_SMALL_MAX && G_vars.cache_sz)
+    {
+        const size_t cls = my_malloc_size_class(bytes);
+        void* res = my_malloc_tcache.head[cls];
+
+        if (res)
+        {
+            my_malloc_tcache.head[cls] = *(void**)res;
+            if (--my_malloc_tcache.count[cls] < my_malloc_tcache.low[cls])
+            {
+                my_malloc_tcache.low[cls] = my_malloc_tcache.count[cls];
+            }
+
+            return res;
+        }
+
+        return my_malloc_class(cls);
+    }
+
+    return _malloc(bytes, _heap_arena(), 0);
+}
+
+static void   _my_free(void* ptr)
+{
+    // set an allocation to be freed
+
+    if (!ptr)
+    {
+        return;
+    }
+
+    if (_guard_owns(ptr))
+    {
+        _guard_free(ptr);
+
+        return;
+    }
+
+    if (G_vars.decay_ms)
+    {
+        _tcache_decay();
+    }
+
+    const size_t sz = MY_MALLOC_GET_SIZE((char*)ptr - MY_MALLOC_ALLOC_META);
+
+    if (sz <= MY_MALLOC_SMALL_MAX)
+    {
+        if (G_vars.segregate && _block_foreign(ptr))
+        {
+            // back to its owner, cached here it would be
+            // handed out next to the owner's objects
+
+            _free(ptr);
+
+            return;
+        }
+
+        const size_t cls = my_malloc_size_class(sz);
+
+        if (G_class_sz[cls] == sz && my_malloc_tcache.count[cls] >= G_vars.cache_sz)
+        {
+            _transfer_put(cls);
+        }
+
+        if (G_class_sz[cls] == sz && my_malloc_tcache.count[cls] < G_vars.cache_sz)
+        {
+            _tcache_push(ptr, cls);
+
+            return;
+        }
+    }
+
+    _free(ptr);
+}
+
+static void*  _my_calloc(size_t num, size_t bytes)
+{
+    // allocate zero'd bytes * num bytes if
+    // the product does not overflow
+
+    // Note: See "Notes" section at start of file
+    //       for zero'ing info
+
+    if (MY_MALLOC_CLZ(num) + MY_MALLOC_CLZ(bytes) < MY_MALLOC_NUM_BITS)
+    {
+        // would overflow
+
+        return NULL;
+    }
+
+    const size_t req_bytes = num * bytes;
+
+    if (req_bytes <= MY_MALLOC_SMALL_MAX && G_vars.cache_sz)
+    {
+        // may come from a cache, which is written to
+
+        void* res = _my_malloc(req_bytes);
+        if (res)
+        {
+            memset(res, 0, req_bytes);
+        }
+
+        return res;
+    }
+
+    return _malloc(req_bytes, _heap_arena(), 1);
+}
+
+void* my_malloc(size_t bytes)
+{
+    // allocate bytes, timed if profiling
+
+    if (G_vars.profile)
+    {
+        uint64_t start = _prof_now();
+        void* res = _my_malloc(bytes);
+        _prof_add(MY_MALLOC_LAT_MALLOC, start);
+        _prof_size(bytes);
+
+        return res;
+    }
+
+    return _my_malloc(bytes);
+}
+
+void  my_free(void* ptr)
+{
+    // free ptr, timed if profiling
+
+    if (G_vars.profile)
+    {
+        uint64_t start = _prof_now();
+        _my_free(ptr);
+        _prof_add(MY_MALLOC_LAT_FREE, start);
+
+        return;
+    }
+
+    _my_free(ptr);
+}
+
+void* my_calloc(size_t num, size_t bytes)
+{
+    // allocate zero'd memory, timed if profiling
+
+    if (G_vars.profile)
+    {
+        uint64_t start = _prof_now();
+        void* res = _my_calloc(num, bytes);
+        _prof_add(MY_MALLOC_LAT_CALLOC, start);
+
+        if (!bytes || num <= MY_MALLOC_SMALL_MAX / bytes)
+        {
+            _prof_size(num * bytes);
+        }
+
+        return res;
+    }
+
+    return _my_calloc(num, bytes);
+}
+
+void* my_aligned_alloc(size_t align, size_t bytes)
+{
+    // allocate bytes aligned to align
+
+    return _aligned_alloc(align, bytes, _heap_arena());
+}
+
+void* my_realloc(void *ptr, size_t size)
+{
+    // reallocate previously allocated ptr to
+    // a new size
+    // return pointer to new allocation
+
+    if (G_vars.profile)
+    {
+        uint64_t start = _prof_now();
+        void* res = _realloc(ptr, size, NULL);
+        _prof_add(MY_MALLOC_LAT_REALLOC, start);
+
+        return res;
+    }
+
+    return _realloc(ptr, size, NULL);
+}
+
+struct MallocHeap* my_heap_create()
+{
+    // create a heap with no mappings
+
+    _heap* heap = _mem_get(sizeof(_heap));
+    if (!heap)
+    {
+        return NULL;
+    }
+
+    _heap new_heap = MY_MALLOC_HEAP_INIT;
+    *heap = new_heap;
+
+    return heap;
+}
+
+void* my_heap_malloc(struct MallocHeap* heap, size_t bytes)
+{
+    // allocate bytes on heap
+
+    return _malloc(bytes, heap, 0);
+}
+
+void* my_heap_aligned_alloc(struct MallocHeap* heap, size_t align, size_t bytes)
+{
+    // allocate bytes on heap aligned to align
+
+    return _aligned_alloc(align, bytes, heap);
+}
+
+void  my_heap_free(struct MallocHeap* heap, void* ptr)
+{
+    // set an allocation on heap to be freed
+
+    if (ptr)
+    {
+        _free(ptr);
+    }
+}
+
+void* my_heap_realloc(struct MallocHeap* heap, void* ptr, size_t size)
+{
+    // reallocate ptr, moving it on heap if needed
+
+    return _realloc(ptr, size, heap);
+}
+
+int   my_heap_reserve(struct MallocHeap* heap, size_t bytes, int flags)
+{
+    // map bytes ahead of time for heap
+
+    return _mapping_reserve(bytes, heap, flags);
+}
+
+void  my_heap_destroy(struct MallocHeap* heap)
+{
+    // unmap every mapping of heap, then heap itself
+
+    _mapping* lists[] = { heap->start_map, heap->large_map };
+
+    for (size_t i = 0; i != sizeof(lists) / sizeof(lists[0]); ++i)
+    {
+        _mapping* mapping = lists[i];
+        while (mapping)
+        {
+            _mapping* next = mapping->next;
+            _heap_unmap(mapping->start, (char*)mapping->end - (char*)mapping->start);
+            mapping = next;
+        }
+    }
+
+    munmap(heap, sizeof(_heap));
+}
+
+struct MallocHeap* my_heap_of(struct MallocHeap* heap, void* ptr)
+{
+    // find the heap ptr was allocated from
+
+    if (_guard_owns(ptr))
+    {
+        return NULL;
+    }
+
+    if (_range_owns(ptr))
+    {
+        _mapping* mapping = _range_mapping(ptr);
+        return mapping ? mapping->heap : NULL;
+    }
+
+    for (size_t i = 0; i != MY_MALLOC_MAX_ARENAS + 1; ++i)
+    {
+        _heap* search = i != MY_MALLOC_MAX_ARENAS ? &G_arenas[i] : heap;
+        if (!search)
+        {
+            continue;
+        }
+
+        _heap_lock(search);
+        _mapping* mapping = _mapping_find(ptr, search, 1);
+        atomic_store(&search->is_free, MY_MALLOC_LOCK_FREE);
+
+        if (mapping)
+        {
+            return search;
+        }
+    }
+
+    return NULL;
+}
+
+void  my_heap_stats(struct MallocHeap* heap, struct MallocStats* stats)
+{
+    // fill stats for heap or every arena
+
+    struct MallocStats empty = { 0 };
+    *stats = empty;
+
+    if (heap)
+    {
+        _heap_stats(heap, stats);
+
+        return;
+    }
+
+    for (size_t i = 0; i != MY_MALLOC_MAX_ARENAS; ++i)
+    {
+        _heap_stats(&G_arenas[i], stats);
+    }
+
+    _transfer_stats(stats);
+}
+
+size_t my_heap_hot_blocks(struct MallocHeap* heap, struct MallocHotBlock* hot, size_t num)
+{
+    // fill hot with the most contended blocks of
+    // heap or every arena
+
+    if (heap)
+    {
+        return _heap_hot_blocks(heap, hot, num, 0);
+    }
 
-                curr_sz += MY_MALLOC_GET_SIZE(next) + MY_MALLOC_ALLOC_META;
-            }
+    size_t found = 0;
+    for (size_t i = 0; i != MY_MALLOC_MAX_ARENAS; ++i)
+    {
+        found = _heap_hot_blocks(&G_arenas[i], hot, num, found);
+    }
 
-            MY_MALLOC_SET_SIZE(prev, curr_sz);
+    return found;
+}
 
-            curr = prev;
-            prev = NULL;
+int   my_heap_walk(struct MallocHeap* heap, my_malloc_walk_fn fn, void* ctx)
+{
+    // walk heap or every arena
 
-            curr_sz = old_curr_sz;
-        }
+    if (heap)
+    {
+        return _heap_walk(heap, fn, ctx);
+    }
 
-        if
-        (
-            !MY_MALLOC_GET_AVAILABILITY(curr)
-            &&
-            MY_MALLOC_GET_SIZE(curr) > MY_MALLOC_GET_SIZE(max)
-        )
+    for (size_t i = 0; i != MY_MALLOC_MAX_ARENAS; ++i)
+    {
+        int res = _heap_walk(&G_arenas[i], fn, ctx);
+        if (res)
         {
-            max = curr;
+            return res;
         }
-
-        i += curr_sz + MY_MALLOC_ALLOC_META;
     }
 
-    block_ptr->max_free = MY_MALLOC_GET_SIZE(max);
-    block_ptr->max_free_ptr = max;
+    return 0;
 }
 
-static void*  _block_alloc_unsafe(size_t bytes, void* block)
+void  my_heap_dump(struct MallocHeap* heap, int fd)
 {
-    // allocate bytes from block and update the largest possible
-    // allocation in block
-    // return the start of allocation
+    // write the fragmentation of heap or every
+    // arena to fd
 
-    // Assume: bytes <= block.max_free - ALLOC_META
-
-    _block* block_ptr = block;
-
-    void* alloc_start = (char*)block_ptr->max_free_ptr + MY_MALLOC_ALLOC_META;
-
-    /*  Always add another allocation meta data.
-
-        For exmaple
-        (1500,used) -> (1000,free) -> (2000,used) -> ...
-        Can turn into
-        (1500,used) -> (984,used) -> (0,free) -> (2000,used) -> ...
+    struct MallocDump dump = { .fd = fd, .block = NULL };
 
-        Point is, an allocation meta data will
-        always be added to maintain structure. Even
-        at the cost of wasted space.
-    */
-    size_t remaining = block_ptr->max_free - bytes - MY_MALLOC_ALLOC_META;
+    dprintf(fd, "%18s %10s %10s %10s %10s %6s\n", "block", "size", "used", "free", "largest", "frag");
 
-    MY_MALLOC_SET_INUSE(block_ptr->max_free_ptr, block);
-    MY_MALLOC_SET_SIZE(block_ptr->max_free_ptr, bytes);
+    my_heap_walk(heap, _dump_entry, &dump);
+    _dump_block(&dump);
 
-    // set up meta data for another allocation
-    void* after_insert = MY_MALLOC_NEXT(block_ptr->max_free_ptr);
-    MY_MALLOC_SET_FREE(after_insert);
-    MY_MALLOC_SET_SIZE(after_insert, remaining);
+    dprintf
+    (
+        fd,
+        "%18s %10zu %10zu %10zu %10zu %6.3f\n",
+        "total",
+        dump.total_sz,
+        dump.total_used,
+        dump.total_free,
+        dump.total_hole,
+        _dump_frag(dump.total_free, dump.total_hole)
+    );
+
+    dprintf(fd, "holes\n");
+    for (size_t i = 0; i != MY_MALLOC_NUM_BITS; ++i)
+    {
+        if (dump.holes[i])
+        {
+            dprintf(fd, "%10zu - %10zu %10zu\n", (size_t)1 << i, ((size_t)2 << i) - 1, dump.holes[i]);
+        }
+    }
+}
 
-    _block_update_meta(block);
+static void   _pool_lock(_pool* pool)
+{
+    // wait for sole access to pool
 
-    return alloc_start;
+    char expected = MY_MALLOC_LOCK_FREE;
+    while (!atomic_compare_exchange_strong(&pool->is_free, &expected, MY_MALLOC_LOCK_INSUSE))
+    {
+        expected = MY_MALLOC_LOCK_FREE;
+        _wait_short();
+    }
 }
 
-static void   _block_create_unsafe(size_t sz, void* where)
+static void*  _run_get(size_t bytes, void* next)
 {
-    // create a block of sz starting the block on where
-    // return the total number of bytes taken
-
-    _block* block_ptr = (_block*)where;
+    // get a new run of atleast bytes linked to next
+    // return start of run
 
-    /*  Create the block with a meta data subtracted since
-        initialzation requires two meta data's, but all
-        other cases require one.
-    */
-    _block new_block =
+    size_t sz = _mem_more_sz(bytes);
+    _run* run = _mem_get(sz);
+    if (!run)
     {
-        .sz           = sz,
-        .is_free      = 1,
-        .next         = NULL,
-        .max_free_ptr = (char*)where + sizeof(_block),
-        .max_free     = sz - sizeof(_block) - MY_MALLOC_ALLOC_META
-    };
+        return NULL;
+    }
 
-    *block_ptr = new_block;
+    run->next = next;
+    run->sz   = sz;
 
-    void* initial_alloc = (char*)where + sizeof(_block);
-    MY_MALLOC_SET_FREE(initial_alloc);
-    MY_MALLOC_SET_SIZE(initial_alloc, block_ptr->max_free);
+    return run;
 }
 
-static void*  _block_get(size_t bytes, _mapping** mapping)
+struct MallocPool* my_pool_create(size_t obj_size, size_t align)
 {
-    // try to get a block with enough bytes
-    // return block if found, otherwise null
+    // create an empty pool on a new run
 
-    // Note: never want *mapping to be set to NULL
-    //       unless is was passed as null
-
-    if (!(*mapping))
+    size_t page = sysconf(_SC_PAGESIZE);
+    if (!align || (align & (align - 1)) || align > page)
     {
         return NULL;
     }
 
-    void* block = (*mapping)->start_block;
-    while (block)
+    if (obj_size < sizeof(void*))
     {
-        if (_block_has_room(bytes, block)) // && _block_lock_acquire
-        {
-            return block;
-        }
+        obj_size = sizeof(void*);
+    }
+    if (obj_size > SIZE_MAX - page)
+    {
+        return NULL;
+    }
+    obj_size = (obj_size + align - 1) & ~(align - 1);
+
+    size_t offset = (sizeof(_run) + align - 1) & ~(align - 1);
+    size_t first  = (sizeof(_run) + sizeof(_pool) + align - 1) & ~(align - 1);
 
-        block = ((_block*)block)->next;
+    _run* run = _run_get(first + obj_size, NULL);
+    if (!run)
+    {
+        return NULL;
     }
 
-    while((*mapping)->next)
+    _pool* pool = (_pool*)((char*)run + sizeof(_run));
+
+    _pool new_pool =
     {
-        while (block)
+        .obj_sz     = obj_size,
+        .obj_offset = offset,
+        .free_list  = NULL,
+        .bump       = (char*)run + first,
+        .bump_end   = (char*)run + run->sz,
+        .runs       = run,
+        .is_free    = MY_MALLOC_LOCK_FREE
+    };
+    *pool = new_pool;
+
+    return pool;
+}
+
+void* my_pool_alloc(struct MallocPool* pool)
+{
+    // take the most recently freed object, otherwise
+    // the next never used one
+
+    _pool_lock(pool);
+
+    void* res = pool->free_list;
+    if (res)
+    {
+        pool->free_list = *(void**)res;
+    }
+    else
+    {
+        if ((size_t)(pool->bump_end - pool->bump) < pool->obj_sz)
         {
-            if (_block_has_room(bytes, block)) // && _block_lock_acquire
+            _run* run = _run_get(pool->obj_offset + pool->obj_sz, pool->runs);
+            if (!run)
             {
-                return block;
+                atomic_store(&pool->is_free, MY_MALLOC_LOCK_FREE);
+
+                return NULL;
             }
 
-            block = ((_block*)block)->next;
+            pool->runs     = run;
+            pool->bump     = (char*)run + pool->obj_offset;
+            pool->bump_end = (char*)run + run->sz;
         }
 
-        *mapping = (*mapping)->next;
+        res = pool->bump;
+        pool->bump += pool->obj_sz;
     }
 
-    return NULL;
+    atomic_store(&pool->is_free, MY_MALLOC_LOCK_FREE);
+
+    return res;
 }
 
-static int    _mapping_has_room(size_t block_sz, _mapping* mapping)
+void  my_pool_free(struct MallocPool* pool, void* ptr)
 {
-    // whether mapping has enough room for bytes
-    // return 1 if yes, 0 otherwise
+    // put ptr at the front of the free list
 
-    _block* end_block = mapping->end_block;
-    char* inuse_end = (char*)mapping->end_block + end_block->sz;
+    _pool_lock(pool);
 
-    return block_sz > (char*)mapping->end - inuse_end;
+    *(void**)ptr = pool->free_list;
+    pool->free_list = ptr;
+
+    atomic_store(&pool->is_free, MY_MALLOC_LOCK_FREE);
 }
 
-static _map   _mapping_create_unsafe(size_t sz)
+void  my_pool_destroy(struct MallocPool* pool)
 {
-    // create mapping capable of holding sz
-    // return where the mapping is created
+    // unmap every run
 
-    size_t more_mem = _mem_more_sz(sz + sizeof(_mapping));
-    void* start = _mem_get(more_mem);
-    if (!start)
+    /*  The pool lives in the last run in the list,
+        so it is never read after being unmapped.
+    */
+
+    _run* run = pool->runs;
+    while (run)
     {
-        return NULL;
+        _run* next = run->next;
+        munmap(run, run->sz);
+        run = next;
     }
+}
 
-    _mapping new_mapping =
-    {
-        .start       = start,
-        .end         = (char*)start + more_mem,
-        .start_block = NULL,
-        .end_block   = NULL,
-        .next        = NULL
-    };
-    _mapping* mapping = start;
-    *mapping = new_mapping;
+/*  Alignment of every region allocation.
+*/
+#define MY_MALLOC_REGION_ALIGN \
+    _Alignof(max_align_t)
 
-    return start;
-}
+/*  Where allocations start in a region run.
+*/
+#define MY_MALLOC_REGION_OFFSET \
+    ((sizeof(_run) + MY_MALLOC_REGION_ALIGN - 1) & ~(MY_MALLOC_REGION_ALIGN - 1))
+
+/*  Where allocations start in the first run of
+    a region, after the region itself.
+*/
+#define MY_MALLOC_REGION_FIRST \
+    ((sizeof(_run) + sizeof(_region) + MY_MALLOC_REGION_ALIGN - 1) & ~(MY_MALLOC_REGION_ALIGN - 1))
 
-static void*  _mapping_create(size_t bytes, _mapping** mapping)
+static void   _region_free_large(_region* region)
 {
-    // request a mapping with bytes allocated onto it
-    // return the start of allocation
+    // free every allocation of region which
+    // came from my_malloc
 
-    size_t block_sz = MY_MALLOC_BLOCK_EXPANSION(bytes);
-    void* new_mapping = _mapping_create_unsafe(block_sz + sizeof(_mapping));
-    if (!new_mapping)
+    void** large = region->large;
+    while (large)
     {
-        return NULL;
+        void** next = large[-2];
+        my_free(large[-1]);
+        large = next;
     }
-    *mapping = new_mapping;
-
-    void* where = (char*)new_mapping + sizeof(_mapping);
-
-    _block_create_unsafe(block_sz, where);
 
-    (*mapping)->start_block = where;
-    (*mapping)->end_block = where;
-
-    return _block_alloc_unsafe(bytes, where);
+    region->large = NULL;
 }
 
-static void*  _mapping_append_block(size_t block_sz, _mapping* mapping)
+struct MallocRegion* my_region_create()
 {
-    // add block to the end of mapping
-    // return start of new block
+    // create an empty region on a new run
+
+    _run* run = _run_get(MY_MALLOC_REGION_FIRST, NULL);
+    if (!run)
+    {
+        return NULL;
+    }
 
-    // Assume: mapping has enough room for block_sz
+    _region* region = (_region*)((char*)run + sizeof(_run));
 
-    _block* end_block = mapping->end_block;
-    void* new_block = (char*)mapping->end_block + end_block->sz;
-    
-    _block_create_unsafe(block_sz, new_block);
-    
-    mapping->end_block = new_block;
-    end_block->next = new_block;
+    _region new_region =
+    {
+        .bump     = (char*)run + MY_MALLOC_REGION_FIRST,
+        .bump_end = (char*)run + run->sz,
+        .curr     = run,
+        .first    = run,
+        .large    = NULL
+    };
+    *region = new_region;
 
-    return new_block;
+    return region;
 }
 
-static void*  _advanced_malloc(size_t bytes, char search, void* block, _mapping* mapping)
+void* my_region_alloc(struct MallocRegion* region, size_t bytes)
 {
-    // get an allocation of bytes beginning by looking
-    // from block and mapping
-    // only search for block if indicated
-
-    /*  NEED depth limiter on search
-    */
+    // bump allocate bytes
 
-    if (search)
+    if (bytes >= G_vars.large_sz)
     {
-        void* block_res = _block_get(bytes, &mapping);
+        /*  my_malloc only aligns to MY_MALLOC_ALIGN. Room
+            is left to align, with the next allocation and
+            what my_malloc gave right in front.
+        */
 
-        if (block_res)
+        char* base = my_malloc((2 * MY_MALLOC_REGION_ALIGN) + bytes);
+        if (!base)
         {
-            if (_block_acquire(bytes, block_res))
-            {
-                void* res = _block_alloc_unsafe(bytes, block_res);
-                _block_lock_free(block_res);
-
-                return res;
-            }
+            return NULL;
         }
-    }
 
-    ++search;
+        uintptr_t at = (uintptr_t)base + (2 * sizeof(void*));
+        void** large = (void**)((at + MY_MALLOC_REGION_ALIGN - 1) & ~(MY_MALLOC_REGION_ALIGN - 1));
 
-    /*  Failed to find a block. No matter what will have
-        to modify atleast one mapping.
-    */
+        large[-1] = base;
+        large[-2] = region->large;
+        region->large = large;
 
-    char expected = MY_MALLOC_LOCK_FREE;
-    if (atomic_compare_exchange_strong(&G_global.is_free, &expected, MY_MALLOC_LOCK_INSUSE))
+        return large;
+    }
+
+    bytes = (bytes + MY_MALLOC_REGION_ALIGN - 1) & ~(MY_MALLOC_REGION_ALIGN - 1);
+
+    if ((size_t)(region->bump_end - region->bump) < bytes)
     {
-        size_t block_sz = MY_MALLOC_BLOCK_EXPANSION(bytes);
+        // move onto a run kept from before a reset if
+        // there is one, otherwise insert a new one
 
-        if (!mapping || !_mapping_has_room(block_sz, mapping))
+        _run* next = region->curr->next;
+        if (!next || next->sz - MY_MALLOC_REGION_OFFSET < bytes)
         {
-            // mapping is null or does not have enough room
-            // for a new block of necessary size
-
-            void* res = _mapping_create(bytes, &mapping);
-            atomic_store(&G_global.is_free, MY_MALLOC_LOCK_FREE);
+            next = _run_get(MY_MALLOC_REGION_OFFSET + bytes, region->curr->next);
+            if (!next)
+            {
+                return NULL;
+            }
 
-            return res;
+            region->curr->next = next;
         }
 
-        void* new_block = _mapping_append_block(block_sz, mapping);
-        atomic_store(&G_global.is_free, MY_MALLOC_LOCK_FREE);
-
-        return _block_alloc_unsafe(bytes, new_block);
+        region->curr     = next;
+        region->bump     = (char*)next + MY_MALLOC_REGION_OFFSET;
+        region->bump_end = (char*)next + next->sz;
     }
 
-    _wait_long();
+    void* res = region->bump;
+    region->bump += bytes;
 
-    return _advanced_malloc(bytes, search, block, mapping);
+    return res;
 }
 
-void* my_malloc(size_t bytes)
+void  my_region_reset(struct MallocRegion* region)
 {
-    // allocate bytes somewhere on the heap
-    // return pointer to allocated space
+    // rewind to the start of the first run
 
-    _mapping* mapping = G_global.start_map;
-    void* block = _block_get(bytes, &mapping);
+    _region_free_large(region);
 
-    if (block)
-    {
-        if (_block_acquire(bytes, block))
-        {
-            void* res = _block_alloc_unsafe(bytes, block);
-            _block_lock_free(block);
+    region->curr     = region->first;
+    region->bump     = (char*)region->first + MY_MALLOC_REGION_FIRST;
+    region->bump_end = (char*)region->first + region->first->sz;
+}
 
-            return res;
-        }
+void  my_region_destroy(struct MallocRegion* region)
+{
+    // unmap every run
+
+    _region_free_large(region);
+
+    _run* first = region->first;
+    _run* run = first->next;
+    while (run)
+    {
+        _run* next = run->next;
+        munmap(run, run->sz);
+        run = next;
     }
 
-    return _advanced_malloc(bytes, 0, block, mapping);
+    munmap(first, first->sz);
 }
 
-void  my_free(void* ptr)
+size_t my_malloc_usable_size(void* ptr)
 {
-    // set an allocation to be freed
+    // bytes which can be used at ptr
 
-    void* block = MY_MALLOC_GET_AVAILABILITY((char*)ptr - MY_MALLOC_ALLOC_META);
-
-    while (!_block_acquire(0, block))
+    if (!ptr)
     {
-        _wait_short();
+        return 0;
     }
 
-    MY_MALLOC_SET_FREE((char*)ptr - MY_MALLOC_ALLOC_META);
-    _block_update_meta(block);
-    
-    _block_lock_free(block);
+    return MY_MALLOC_GET_SIZE((char*)ptr - MY_MALLOC_ALLOC_META);
 }
 
-void* my_calloc(size_t num, size_t bytes)
+size_t my_malloc_good_size(size_t bytes)
 {
-    // allocate zero'd bytes * num bytes if
-    // the product does not overflow
+    // bytes my_malloc would really give for a
+    // request of bytes
 
-    // Note: See "Notes" section at start of file
-    //       for zero'ing info
+    if (bytes <= MY_MALLOC_SMALL_MAX && G_vars.cache_sz)
+    {
+        return G_class_sz[my_malloc_size_class(bytes)];
+    }
 
-    if (MY_MALLOC_CLZ(num) + MY_MALLOC_CLZ(bytes) < MY_MALLOC_NUM_BITS)
+    size_t page = sysconf(_SC_PAGESIZE);
+    if (bytes >= G_vars.large_sz)
     {
-        // would overflow
+        if (bytes > SIZE_MAX - MY_MALLOC_LARGE_META - page)
+        {
+            return bytes;
+        }
 
-        return NULL;
+        return MY_MALLOC_ROUND(bytes + MY_MALLOC_LARGE_META, page) - MY_MALLOC_LARGE_META;
     }
 
-    const size_t req_bytes = num * bytes;
-    void* res = my_malloc(req_bytes);
-    memset(res, 0, req_bytes);
-
-    return res;
+    return MY_MALLOC_NODE_SZ(bytes);
 }
 
-void* my_realloc(void *ptr, size_t size)
+int   my_malloc_reserve(size_t bytes, int flags)
 {
-    // reallocate previously allocated ptr to
-    // a new size
-    // return pointer to new allocation
+    // map bytes ahead of time for the calling
+    // thread's heap
 
-    // can reduce the two ifs down
+    return _mapping_reserve(bytes, _heap_arena(), flags);
+}
 
-    void* alloc_meta = (char*)ptr - MY_MALLOC_ALLOC_META;
-    void* block = MY_MALLOC_GET_AVAILABILITY(alloc_meta);
+void  my_malloc_latency(int kind, struct MallocLatency* lat)
+{
+    // fill lat from the histograms of kind of
+    // every thread
 
-    while (!_block_acquire(0, block))
+    struct MallocLatency empty = { 0 };
+    *lat = empty;
+
+    if (kind < 0 || kind >= MY_MALLOC_LAT_KINDS)
     {
-        _wait_short();
+        return;
     }
 
-    size_t curr_sz = MY_MALLOC_GET_SIZE(alloc_meta), next_new_sz = 0;
+    uint64_t hist[MY_MALLOC_PROF_BUCKETS] = { 0 };
 
-    if (size <= curr_sz)
+    for (_profile* profile = atomic_load(&G_profiles); profile; profile = profile->next)
     {
-        // shrink current allocation
+        for (size_t i = 0; i != MY_MALLOC_PROF_BUCKETS; ++i)
+        {
+            hist[i] += profile->hist[kind][i];
+            lat->count += profile->hist[kind][i];
+        }
+    }
 
-        size_t diff = curr_sz - size;
-        size_t next_curr_sz = MY_MALLOC_GET_SIZE(MY_MALLOC_NEXT(alloc_meta));
+    /*  Percentile p is the first bucket by which
+        atleast p of the counts are seen.
+    */
 
-        next_new_sz = next_curr_sz + diff;
-    }
+    size_t seen = 0;
+    size_t* res[] = { &lat->p50, &lat->p99, &lat->p999 };
+    double at[] = { 0.5, 0.99, 0.999 };
+    size_t next = 0;
 
-    void* next = MY_MALLOC_NEXT(alloc_meta);
-    if
-    (
-        !MY_MALLOC_GET_AVAILABILITY(next)
-        &&
-        size <= curr_sz + MY_MALLOC_GET_SIZE(next)
-    )
+    for (size_t i = 0; i != MY_MALLOC_PROF_BUCKETS; ++i)
     {
-        // expand current allocation
+        if (!hist[i])
+        {
+            continue;
+        }
 
-        size_t next_curr_sz = MY_MALLOC_GET_SIZE(MY_MALLOC_NEXT(alloc_meta));
+        seen += hist[i];
 
-        next_new_sz = (next_curr_sz + curr_sz) -  size;
+        for (; next != sizeof(at) / sizeof(at[0]) && seen >= at[next] * lat->count; ++next)
+        {
+            *res[next] = _prof_bucket_max(i);
+        }
+
+        lat->max = _prof_bucket_max(i);
     }
+}
 
-    if (next_new_sz)
+void  my_malloc_latency_reset()
+{
+    // zero the histograms of every thread, counts
+    // being added at the same time may be lost
+
+    for (_profile* profile = atomic_load(&G_profiles); profile; profile = profile->next)
     {
-        MY_MALLOC_SET_SIZE(alloc_meta, size);
+        memset(profile->hist, 0, sizeof(profile->hist));
+        memset(profile->sizes, 0, sizeof(profile->sizes));
+    }
+}
 
-        void* next_new = MY_MALLOC_NEXT(alloc_meta);
-        MY_MALLOC_SET_SIZE(next_new, next_new_sz);
-        MY_MALLOC_SET_INUSE(next_new, block);
+void  my_malloc_size_dump(int fd)
+{
+    // write the sizes requested over every thread
 
-        _block_update_meta(block);
+    dprintf(fd, "# size count\n");
 
-        _block_lock_free(block);
+    for (size_t i = 0; i != MY_MALLOC_PROF_SIZES; ++i)
+    {
+        uint64_t count = 0;
+        for (_profile* profile = atomic_load(&G_profiles); profile; profile = profile->next)
+        {
+            count += profile->sizes[i];
+        }
 
-        return ptr;
+        if (count)
+        {
+            size_t sz = (i + 1) * MY_MALLOC_PROF_SIZE_STEP;
+            dprintf(fd, "%zu %llu\n", sz < MY_MALLOC_SMALL_MAX ? sz : MY_MALLOC_SMALL_MAX, (unsigned long long)count);
+        }
     }
+}
 
-    // new allocation and copy
-    void* new_ptr = my_malloc(size);
-
-    memcpy(new_ptr, ptr, curr_sz);
+int   my_mallopt(int param, size_t value)
+{
+    // set an adjustable
 
-    _block_lock_free(block);
-    
-    return new_ptr;
+    return _vars_set(param, value);
 }
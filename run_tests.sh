@@ -2,7 +2,7 @@
 
 base_dir=build/tests
 # group_order="realloc-malloc"
-group_order="malloc calloc free-malloc realloc-malloc multi-thread"
+group_order="malloc calloc free-malloc realloc-malloc multi-thread mallopt pool region heap guard profile decay publish cpp"
 
 make tests >> /dev/null
 if [ "$?" -ne 0 ]; then
@@ -0,0 +1,58 @@
+// memory handed back by free is written to, a
+// calloc reusing it must still be zero
+
+#include <custom_mem/malloc.h>
+#include <string.h>
+
+static int is_zero(const char* ptr, size_t bytes)
+{
+    for (size_t i = 0; i != bytes; ++i)
+    {
+        if (ptr[i])
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+int main(int argc, char const *argv[])
+{
+    // up to and past the large limit, with a block big
+    // enough for madvise to be used
+    const size_t sizes[] = { 24, 3000, 60000, 127000, 4000000 };
+
+    my_mallopt(MY_M_LARGE, 1048576);
+
+    for (size_t i = 0; i != sizeof(sizes) / sizeof(sizes[0]); ++i)
+    {
+        char* dirty = my_malloc(sizes[i]);
+        char* after = my_malloc(16);
+        memset(dirty, 0xff, sizes[i]);
+        memset(after, 0xff, 16);
+        my_free(dirty);
+
+        char* res = my_calloc(1, sizes[i]);
+        if (!res || !is_zero(res, sizes[i]))
+        {
+            return -1;
+        }
+        memset(res, 0xff, sizes[i]);
+
+        // grows into space it has never had
+        res = my_realloc(res, sizes[i] + 512);
+        my_free(res);
+
+        res = my_calloc(sizes[i] + 512, 1);
+        if (!res || !is_zero(res, sizes[i] + 512))
+        {
+            return -1;
+        }
+
+        my_free(res);
+        my_free(after);
+    }
+
+    return 0;
+}
@@ -0,0 +1,71 @@
+// replace the global operator new and delete and
+// check every form ends up on the allocator
+
+#define MY_MALLOC_REPLACE_NEW
+#include <custom_mem/malloc.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+struct alignas(256) Page
+{
+    char bytes[256];
+};
+
+static int owned(const void* ptr, std::size_t align)
+{
+    return my_heap_of(NULL, const_cast<void*>(ptr)) != NULL && reinterpret_cast<std::uintptr_t>(ptr) % align == 0;
+}
+
+int main(int argc, char const *argv[])
+{
+    int* one = new int(1);
+    long double* many = new long double[100];
+    Page* page = new Page;
+    Page* pages = new Page[10];
+    char* nothrow = new (std::nothrow) char[50];
+    std::unique_ptr<std::string> str = std::make_unique<std::string>(1000, 'a');
+
+    if (
+        !owned(one, alignof(int)) ||
+        !owned(many, __STDCPP_DEFAULT_NEW_ALIGNMENT__) ||
+        !owned(page, alignof(Page)) ||
+        !owned(pages, alignof(Page)) ||
+        !owned(nothrow, 1) ||
+        !owned(str->data(), 1)
+    )
+    {
+        return -1;
+    }
+
+    delete one;
+    delete[] many;
+    delete page;
+    delete[] pages;
+    delete[] nothrow;
+
+    // default aligned, so from the thread cache the
+    // sized delete just put it in
+    void* first = ::operator new(48);
+    ::operator delete(first, 48);
+    void* second = ::operator new(48);
+    if (second != first || !owned(second, __STDCPP_DEFAULT_NEW_ALIGNMENT__))
+    {
+        return -1;
+    }
+    ::operator delete(second, 48);
+
+    // too large to ever succeed
+    volatile std::size_t huge_sz = SIZE_MAX / 4;
+    try
+    {
+        char* huge = new char[huge_sz];
+        delete[] huge;
+
+        return -1;
+    }
+    catch (const std::bad_alloc&)
+    {}
+
+    return 0;
+}
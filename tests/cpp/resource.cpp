@@ -0,0 +1,64 @@
+// fill pmr containers from each memory resource and
+// a vector with the stl allocator, and check where
+// their memory came from
+
+#include <custom_mem/malloc.hpp>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#define NUM_ITEMS 10000
+
+struct alignas(64) Line
+{
+    char bytes[64];
+};
+
+int main(int argc, char const *argv[])
+{
+    struct MallocHeap* heap = my_heap_create();
+    struct MallocRegion* region = my_region_create();
+
+    {
+        custom_mem::heap_resource on_heap(heap);
+        custom_mem::region_resource on_region(region);
+
+        std::pmr::vector<int> ints(custom_mem::get_malloc_resource());
+        std::pmr::map<int, std::pmr::string> names(&on_heap);
+        std::pmr::vector<Line> lines(&on_region);
+
+        for (int i = 0; i != NUM_ITEMS; ++i)
+        {
+            ints.push_back(i);
+            names.emplace(i, std::pmr::string(100, 'a'));
+            lines.push_back(Line());
+        }
+
+        if (
+            my_heap_of(NULL, ints.data()) == NULL ||
+            my_heap_of(heap, &names.begin()->second) != heap ||
+            reinterpret_cast<std::uintptr_t>(lines.data()) % alignof(Line) ||
+            !on_heap.is_equal(custom_mem::heap_resource(heap)) ||
+            on_heap.is_equal(*custom_mem::get_malloc_resource())
+        )
+        {
+            return -1;
+        }
+
+        std::vector<Line, custom_mem::allocator<Line>> aligned(NUM_ITEMS);
+        if (reinterpret_cast<std::uintptr_t>(aligned.data()) % alignof(Line) || my_heap_of(NULL, aligned.data()) == NULL)
+        {
+            return -1;
+        }
+    }
+
+    // every container gave back what it took
+    struct MallocStats stats = { 0 };
+    my_heap_stats(heap, &stats);
+
+    my_region_destroy(region);
+    my_heap_destroy(heap);
+
+    return stats.in_use ? -1 : 0;
+}
@@ -0,0 +1,155 @@
+// free everything, then wait for the decay
+// thread to give back the idle free space and
+// the idle batches of the transfer cache, and
+// for this thread to trim its idle cache
+
+#include <custom_mem/malloc.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#define NUM_ALLOCS 64
+#define SZ         32768
+#define NUM_SMALL  200
+#define SMALL_SZ   64
+
+// most waits of 10ms for the thread
+#define MAX_WAITS 200
+
+static void* smalls[NUM_SMALL];
+
+static void* release(void* arg)
+{
+    for (size_t i = 0; i != NUM_SMALL; ++i)
+    {
+        my_free(smalls[i]);
+    }
+
+    return NULL;
+}
+
+static int wait_for(int (*done)(struct MallocStats*))
+{
+    struct timespec wait = { 0, 10000000 };
+
+    for (size_t i = 0; i != MAX_WAITS; ++i)
+    {
+        struct MallocStats stats = { 0 };
+        my_heap_stats(NULL, &stats);
+
+        if (done(&stats))
+        {
+            return 1;
+        }
+
+        nanosleep(&wait, NULL);
+    }
+
+    return 0;
+}
+
+static int purged(struct MallocStats* stats)
+{
+    return stats->purged >= SZ && stats->purged <= stats->mapped;
+}
+
+static int transferred(struct MallocStats* stats)
+{
+    return !stats->transfer;
+}
+
+static int trimmed()
+{
+    // free between waits, which is when the cache
+    // is trimmed
+
+    struct timespec wait = { 0, 10000000 };
+    size_t cls = my_malloc_size_class(SMALL_SZ);
+
+    for (size_t i = 0; i != MAX_WAITS; ++i)
+    {
+        my_free(my_malloc(SZ));
+
+        if (!my_malloc_tcache.count[cls])
+        {
+            return 1;
+        }
+
+        nanosleep(&wait, NULL);
+    }
+
+    return 0;
+}
+
+int main(int argc, char const *argv[])
+{
+    if (!my_mallopt(MY_M_DECAY, 20))
+    {
+        return -1;
+    }
+
+    char* ptrs[NUM_ALLOCS];
+    for (size_t i = 0; i != NUM_ALLOCS; ++i)
+    {
+        ptrs[i] = my_malloc(SZ);
+        memset(ptrs[i], 1, SZ);
+    }
+    for (size_t i = 0; i != NUM_ALLOCS; ++i)
+    {
+        my_free(ptrs[i]);
+    }
+
+    if (!wait_for(purged))
+    {
+        return -1;
+    }
+
+    // given back pages come back on use
+    for (size_t i = 0; i != NUM_ALLOCS; ++i)
+    {
+        ptrs[i] = my_malloc(SZ);
+        memset(ptrs[i], 2, SZ);
+    }
+    for (size_t i = 0; i != NUM_ALLOCS; ++i)
+    {
+        if (ptrs[i][SZ - 1] != 2)
+        {
+            return -1;
+        }
+        my_free(ptrs[i]);
+    }
+
+    // batches left behind by an exited thread
+    for (size_t i = 0; i != NUM_SMALL; ++i)
+    {
+        smalls[i] = my_malloc(SMALL_SZ);
+    }
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, release, NULL) || pthread_join(thread, NULL))
+    {
+        return -1;
+    }
+
+    if (!wait_for(transferred))
+    {
+        return -1;
+    }
+
+    // cached here and never taken again
+    for (size_t i = 0; i != NUM_SMALL; ++i)
+    {
+        smalls[i] = my_malloc(SMALL_SZ);
+    }
+    for (size_t i = 0; i != NUM_SMALL; ++i)
+    {
+        my_free(smalls[i]);
+    }
+
+    if (!my_malloc_tcache.count[my_malloc_size_class(SMALL_SZ)])
+    {
+        return -1;
+    }
+
+    return trimmed() ? 0 : -1;
+}
@@ -0,0 +1,106 @@
+// check frees wait to be merged with coalesce set,
+// and are merged when the pending frees reach it or
+// an allocation finds no room
+
+#include <custom_mem/malloc.h>
+
+#define NUM_ALLOCS 8
+#define ALLOC_SZ   100
+
+static size_t pending(struct MallocHeap* heap)
+{
+    struct MallocStats stats;
+    my_heap_stats(heap, &stats);
+
+    return stats.block_pending;
+}
+
+int main(int argc, char const *argv[])
+{
+    if (!my_mallopt(MY_M_COALESCE, 64))
+    {
+        return -1;
+    }
+
+    struct MallocHeap* heap = my_heap_create();
+
+    char* ptrs[NUM_ALLOCS];
+    for (size_t i = 0; i != NUM_ALLOCS; ++i)
+    {
+        ptrs[i] = my_heap_malloc(heap, ALLOC_SZ);
+        if (!ptrs[i])
+        {
+            return -1;
+        }
+
+        // one after another in the same block
+        if (i && ptrs[i] != ptrs[i - 1] + 112 + 16)
+        {
+            return -1;
+        }
+    }
+
+    // leave a run of free nodes between the first and last
+    for (size_t i = 1; i != NUM_ALLOCS - 1; ++i)
+    {
+        my_heap_free(heap, ptrs[i]);
+    }
+
+    if (pending(heap) != NUM_ALLOCS - 2)
+    {
+        return -1;
+    }
+
+    struct MallocStats before;
+    my_heap_stats(heap, &before);
+
+    // fits only in the run merged whole, with room
+    // for the meta data always following
+    char* big = my_heap_malloc(heap, ((NUM_ALLOCS - 2) * (112 + 16)) - 32);
+    if (big != ptrs[1] || pending(heap))
+    {
+        return -1;
+    }
+
+    struct MallocStats after;
+    my_heap_stats(heap, &after);
+
+    if (after.mapped != before.mapped)
+    {
+        return -1;
+    }
+
+    my_heap_free(heap, big);
+    my_heap_free(heap, ptrs[0]);
+    my_heap_free(heap, ptrs[NUM_ALLOCS - 1]);
+
+    // merged once as many are pending as allowed
+    my_mallopt(MY_M_COALESCE, 3);
+
+    char* a = my_heap_malloc(heap, ALLOC_SZ);
+    char* b = my_heap_malloc(heap, ALLOC_SZ);
+    char* c = my_heap_malloc(heap, ALLOC_SZ);
+
+    my_heap_free(heap, a);
+    my_heap_free(heap, b);
+    if (pending(heap) != 2)
+    {
+        return -1;
+    }
+
+    my_heap_free(heap, c);
+    if (pending(heap))
+    {
+        return -1;
+    }
+
+    my_heap_stats(heap, &after);
+    if (after.in_use || after.free != after.free_max)
+    {
+        return -1;
+    }
+
+    my_heap_destroy(heap);
+
+    return 0;
+}
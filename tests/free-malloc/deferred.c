@@ -0,0 +1,88 @@
+// free allocations while their block is held, which
+// leaves them for the holder linked through their first
+// bytes, and check a 0 byte one leaves its neighbour
+// untouched and a full block gets its space back
+
+#include <custom_mem/malloc.h>
+#include <string.h>
+
+#define NEXT_SZ 64
+#define FULL_SZ 2000
+
+struct Ctx
+{
+    struct MallocHeap* heap;
+    char*              zero;
+};
+
+static int free_zero(const struct MallocWalkEntry* entry, void* arg)
+{
+    // the walk holds the block, so the free is only
+    // left on it, then stop before reading further
+
+    struct Ctx* ctx = arg;
+
+    if (entry->kind == MY_MALLOC_WALK_ALLOC && entry->addr == ctx->zero)
+    {
+        my_heap_free(ctx->heap, ctx->zero);
+
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char const *argv[])
+{
+    struct MallocHeap* heap = my_heap_create();
+
+    struct Ctx ctx = { heap, my_heap_malloc(heap, 0) };
+    char* next = my_heap_malloc(heap, NEXT_SZ);
+    if (!ctx.zero || !next)
+    {
+        return -1;
+    }
+
+    memset(next, 1, NEXT_SZ);
+
+    if (my_heap_walk(heap, free_zero, &ctx) != 1)
+    {
+        return -1;
+    }
+
+    struct MallocStats stats;
+    my_heap_stats(heap, &stats);
+    if (stats.block_deferred != 1 || my_malloc_usable_size(next) != NEXT_SZ)
+    {
+        return -1;
+    }
+
+    next = my_heap_realloc(heap, next, 4 * NEXT_SZ);
+    for (size_t i = 0; i != NEXT_SZ; ++i)
+    {
+        if (next[i] != 1)
+        {
+            return -1;
+        }
+    }
+
+    my_heap_free(heap, next);
+    my_heap_destroy(heap);
+
+    // a block with no room is never searched, so its
+    // frees must be taken when the holder lets go
+
+    heap = my_heap_create();
+
+    ctx.heap = heap;
+    ctx.zero = my_heap_malloc(heap, FULL_SZ);
+
+    if (my_heap_walk(heap, free_zero, &ctx) != 1 || my_heap_malloc(heap, FULL_SZ) != ctx.zero)
+    {
+        return -1;
+    }
+
+    my_heap_destroy(heap);
+
+    return 0;
+}
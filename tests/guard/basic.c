@@ -0,0 +1,96 @@
+// sample every allocation into a guard slot and make
+// sure they behave like any other allocation
+
+#include <custom_mem/malloc.h>
+#include <string.h>
+
+#define NUM_ALLOCS 64
+
+int main(int argc, char const *argv[])
+{
+    if (!my_mallopt(MY_M_GUARD_SLOTS, 16) || !my_mallopt(MY_M_GUARD_RATE, 1))
+    {
+        return -1;
+    }
+
+    // nothing requested still stays in its own slot,
+    // freeing it leaves the next one be
+    char* zero = my_malloc(0);
+    char* after = my_malloc(100);
+    if (!zero || !after || my_malloc_usable_size(zero) == 0)
+    {
+        return -1;
+    }
+    my_free(zero);
+    memset(after, 1, 100);
+    my_free(after);
+
+    char* ptrs[NUM_ALLOCS];
+
+    for (size_t i = 0; i != NUM_ALLOCS; ++i)
+    {
+        ptrs[i] = my_malloc(i + 1);
+        if (!ptrs[i] || my_malloc_usable_size(ptrs[i]) < i + 1)
+        {
+            return -1;
+        }
+
+        memset(ptrs[i], (int)i, i + 1);
+    }
+
+    // only so many slots, the rest come from the heap
+    if (my_mallopt(MY_M_GUARD_SLOTS, 32))
+    {
+        return -1;
+    }
+
+    for (size_t i = 0; i != NUM_ALLOCS; ++i)
+    {
+        for (size_t j = 0; j != i + 1; ++j)
+        {
+            if (ptrs[i][j] != (char)i)
+            {
+                return -1;
+            }
+        }
+    }
+
+    // moves out of the slot and keeps contents
+    ptrs[0] = my_realloc(ptrs[0], 5000);
+    if (!ptrs[0] || ptrs[0][0] != 0)
+    {
+        return -1;
+    }
+
+    for (size_t i = 0; i != NUM_ALLOCS; ++i)
+    {
+        my_free(ptrs[i]);
+    }
+
+    // freed slots are reused
+    for (size_t i = 0; i != NUM_ALLOCS; ++i)
+    {
+        ptrs[i] = my_calloc(1, 100);
+        if (!ptrs[i])
+        {
+            return -1;
+        }
+
+        for (size_t j = 0; j != 100; ++j)
+        {
+            if (ptrs[i][j])
+            {
+                return -1;
+            }
+        }
+
+        memset(ptrs[i], 1, 100);
+    }
+
+    for (size_t i = 0; i != NUM_ALLOCS; ++i)
+    {
+        my_free(ptrs[i]);
+    }
+
+    return 0;
+}
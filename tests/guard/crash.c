@@ -0,0 +1,104 @@
+// make sure bad accesses to sampled allocations
+// fault and are reported
+
+#include <custom_mem/malloc.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static int expect_fault(void (*fn)(void), const char* msg)
+{
+    // run fn in a child and check it is killed
+    // by SIGSEGV after writing msg to stderr
+    // return 0 if so
+
+    int fds[2];
+    if (pipe(fds))
+    {
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        return -1;
+    }
+
+    if (!pid)
+    {
+        dup2(fds[1], STDERR_FILENO);
+        close(fds[0]);
+
+        fn();
+
+        _exit(0);
+    }
+
+    close(fds[1]);
+
+    char buf[512];
+    size_t len = 0;
+    ssize_t n;
+    while (len != sizeof(buf) - 1 && (n = read(fds[0], buf + len, sizeof(buf) - 1 - len)) > 0)
+    {
+        len += n;
+    }
+    buf[len] = 0;
+    close(fds[0]);
+
+    int status;
+    if (waitpid(pid, &status, 0) != pid)
+    {
+        return -1;
+    }
+
+    if (!WIFSIGNALED(status) || WTERMSIG(status) != SIGSEGV || !strstr(buf, msg))
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+static void overflow()
+{
+    // a multiple of the alignment ends on the page
+    volatile char* ptr = my_malloc(32);
+    ptr[32] = 1;
+}
+
+static void underflow()
+{
+    volatile char* ptr = my_malloc(24);
+    ptr[-(long)sysconf(_SC_PAGESIZE)] = 1;
+}
+
+static void use_after_free()
+{
+    volatile char* ptr = my_malloc(24);
+    my_free((void*)ptr);
+    ptr[0] = 1;
+}
+
+int main(int argc, char const *argv[])
+{
+    if (!my_mallopt(MY_M_GUARD_RATE, 1))
+    {
+        return -1;
+    }
+
+    if
+    (
+        expect_fault(overflow, "buffer overflow")
+        ||
+        expect_fault(underflow, "buffer underflow")
+        ||
+        expect_fault(use_after_free, "use after free")
+    )
+    {
+        return -1;
+    }
+
+    return 0;
+}
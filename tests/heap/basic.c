@@ -0,0 +1,88 @@
+// allocate on two heaps, check their statistics
+// stay apart and that destroying one leaves the
+// other intact
+
+#include <custom_mem/malloc.h>
+#include <string.h>
+
+#define NUM_ALLOCS 1000
+
+static char* first[NUM_ALLOCS];
+static char* second[NUM_ALLOCS];
+
+int main(int argc, char const *argv[])
+{
+    struct MallocHeap* a = my_heap_create();
+    struct MallocHeap* b = my_heap_create();
+    if (!a || !b)
+    {
+        return -1;
+    }
+
+    size_t in_use = 0;
+    for (size_t i = 0; i != NUM_ALLOCS; ++i)
+    {
+        // some are large enough for their own mapping
+        size_t bytes = i % 100 ? i + 1 : 200000 + i;
+
+        first[i]  = my_heap_malloc(a, bytes);
+        second[i] = my_heap_malloc(b, bytes);
+        memset(first[i], 1, bytes);
+        memset(second[i], 2, bytes);
+
+        in_use += my_malloc_usable_size(first[i]);
+    }
+
+    struct MallocStats stats_a, stats_b;
+    my_heap_stats(a, &stats_a);
+    my_heap_stats(b, &stats_b);
+
+    if (stats_a.in_use != in_use || stats_b.in_use != in_use || !stats_a.mapped || !stats_a.num_mmap)
+    {
+        return -1;
+    }
+
+    for (size_t i = 0; i < NUM_ALLOCS; i += 2)
+    {
+        my_heap_free(a, first[i]);
+    }
+
+    for (size_t i = 1; i < NUM_ALLOCS; i += 2)
+    {
+        size_t bytes = i % 100 ? i + 1 : 200000 + i;
+
+        first[i] = my_heap_realloc(a, first[i], bytes * 2);
+        for (size_t j = 0; j != bytes; ++j)
+        {
+            if (first[i][j] != 1)
+            {
+                return -1;
+            }
+        }
+    }
+
+    my_heap_stats(a, &stats_a);
+    if (stats_a.in_use == in_use || stats_a.num_munmap == 0)
+    {
+        return -1;
+    }
+
+    my_heap_destroy(a);
+
+    for (size_t i = 0; i != NUM_ALLOCS; ++i)
+    {
+        size_t bytes = i % 100 ? i + 1 : 200000 + i;
+
+        for (size_t j = 0; j != bytes; ++j)
+        {
+            if (second[i][j] != 2)
+            {
+                return -1;
+            }
+        }
+    }
+
+    my_heap_destroy(b);
+
+    return 0;
+}
@@ -0,0 +1,113 @@
+// check where each fit policy places allocations
+// and that random use of a heap stays intact
+// under every policy
+
+#include <custom_mem/malloc.h>
+#include <stdlib.h> // rand
+#include <string.h>
+
+#define NUM_SLOTS 256
+#define NUM_CALLS 20000
+
+static char*  ptrs[NUM_SLOTS];
+static size_t sizes[NUM_SLOTS];
+
+static int placement(int fit)
+{
+    // holes of 256 then 64 bytes, return where
+    // 48 bytes go, leaving room for the meta data
+    // which always follows
+    // return 1 for the first hole, 2 for the
+    // second, 0 otherwise, such as the rest of
+    // the block
+
+    struct MallocHeap* heap = my_heap_create();
+
+    char* a = my_heap_malloc(heap, 256);
+    char* b = my_heap_malloc(heap, 64);
+    char* c = my_heap_malloc(heap, 64);
+    char* d = my_heap_malloc(heap, 64);
+
+    // c freed last, so is the most recent
+    my_heap_free(heap, a);
+    my_heap_free(heap, c);
+
+    char* res = my_heap_malloc(heap, 48);
+    int where = res == a ? 1 : res == c ? 2 : 0;
+
+    my_heap_free(heap, res);
+    my_heap_free(heap, b);
+    my_heap_free(heap, d);
+    my_heap_destroy(heap);
+
+    return where;
+}
+
+static int churn()
+{
+    // random allocations and frees, checking the
+    // contents of every allocation as it is freed
+    // return 0 if intact
+
+    struct MallocHeap* heap = my_heap_create();
+
+    for (size_t i = 0; i != NUM_CALLS; ++i)
+    {
+        size_t slot = rand() % NUM_SLOTS;
+
+        if (ptrs[slot])
+        {
+            for (size_t j = 0; j != sizes[slot]; ++j)
+            {
+                if (ptrs[slot][j] != (char)slot)
+                {
+                    return -1;
+                }
+            }
+
+            my_heap_free(heap, ptrs[slot]);
+        }
+
+        sizes[slot] = 1 + (rand() % (rand() % 8 ? 256 : 8192));
+        ptrs[slot] = my_heap_malloc(heap, sizes[slot]);
+        if (!ptrs[slot])
+        {
+            return -1;
+        }
+
+        memset(ptrs[slot], (int)slot, sizes[slot]);
+    }
+
+    for (size_t i = 0; i != NUM_SLOTS; ++i)
+    {
+        my_heap_free(heap, ptrs[i]);
+        ptrs[i] = NULL;
+    }
+
+    struct MallocStats stats;
+    my_heap_stats(heap, &stats);
+    my_heap_destroy(heap);
+
+    return stats.in_use ? -1 : 0;
+}
+
+int main(int argc, char const *argv[])
+{
+    if (my_mallopt(MY_M_FIT, MY_MALLOC_FIT_LOWEST + 1))
+    {
+        return -1;
+    }
+
+    int expected[] = { 0, 2, 1, 2, 1 };
+    int fits[] = { MY_MALLOC_FIT_FIRST, MY_MALLOC_FIT_BEST, MY_MALLOC_FIT_NEXT, MY_MALLOC_FIT_LIFO, MY_MALLOC_FIT_LOWEST };
+
+    for (size_t i = 0; i != sizeof(fits) / sizeof(fits[0]); ++i)
+    {
+        if (!my_mallopt(MY_M_FIT, fits[i]) || placement(fits[i]) != expected[i] || churn())
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
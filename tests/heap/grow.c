@@ -0,0 +1,44 @@
+// fill a heap with and without growing mappings
+// and compare the number of mmap calls made
+
+#include <custom_mem/malloc.h>
+
+#define NUM_ALLOCS 20000
+
+static size_t fill()
+{
+    // return number of mmap calls to fill a heap
+
+    struct MallocHeap* heap = my_heap_create();
+
+    for (size_t i = 0; i != NUM_ALLOCS; ++i)
+    {
+        char* ptr = my_heap_malloc(heap, 1000);
+        if (!ptr)
+        {
+            return 0;
+        }
+        ptr[999] = 1;
+    }
+
+    struct MallocStats stats = { 0 };
+    my_heap_stats(heap, &stats);
+    my_heap_destroy(heap);
+
+    return stats.num_mmap;
+}
+
+int main(int argc, char const *argv[])
+{
+    // about 20 MiB, so 1 + 1 + 2 + 4 + 8 + 16
+    size_t grown = fill();
+
+    if (!my_mallopt(MY_M_GROW_MAX, 0))
+    {
+        return -1;
+    }
+
+    size_t flat = fill();
+
+    return grown && grown <= 6 && flat >= 20 ? 0 : -1;
+}
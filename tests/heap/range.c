@@ -0,0 +1,82 @@
+// map every heap from one reserved range and find
+// the heap of pointers, then fill the range past
+// its end
+
+#include <custom_mem/malloc.h>
+
+#define RESERVE 16777216
+
+int main(int argc, char const *argv[])
+{
+    if (!my_mallopt(MY_M_RESERVE, RESERVE))
+    {
+        return -1;
+    }
+
+    struct MallocHeap* heap = my_heap_create();
+
+    char* small = my_heap_malloc(heap, 100);
+    char* large = my_heap_malloc(heap, 1048576);
+    char* other = my_malloc(100);
+    int on_stack;
+
+    if (!small || !large || !other)
+    {
+        return -1;
+    }
+    small[99] = 1;
+    large[1048575] = 1;
+
+    if (
+        my_heap_of(heap, small) != heap ||
+        my_heap_of(heap, large) != heap ||
+        my_heap_of(NULL, small) != heap ||
+        !my_heap_of(NULL, other) ||
+        my_heap_of(NULL, other) == heap ||
+        my_heap_of(heap, &on_stack)
+    )
+    {
+        return -1;
+    }
+
+    // set only before the range is made
+    if (my_mallopt(MY_M_RESERVE, RESERVE))
+    {
+        return -1;
+    }
+
+    my_heap_free(heap, large);
+    if (my_heap_of(heap, large))
+    {
+        return -1;
+    }
+
+    // the range is reused, and zero
+    char* again = my_heap_malloc(heap, 1048576);
+    if (!again || again[1048575] || my_heap_of(NULL, again) != heap)
+    {
+        return -1;
+    }
+
+    // past the range mappings are made on their own
+    for (size_t i = 0; i != 32; ++i)
+    {
+        char* ptr = my_heap_malloc(heap, 1048576);
+        if (!ptr)
+        {
+            return -1;
+        }
+        ptr[0] = 1;
+
+        if (my_heap_of(heap, ptr) != heap)
+        {
+            return -1;
+        }
+    }
+
+    my_heap_destroy(heap);
+
+    my_free(other);
+
+    return 0;
+}
@@ -0,0 +1,73 @@
+// reserve memory for a heap and make sure
+// allocations fit into it without more mmap
+// calls
+
+#include <custom_mem/malloc.h>
+#include <string.h>
+
+#define NUM_ALLOCS 1000
+
+static char* ptrs[NUM_ALLOCS];
+
+int main(int argc, char const *argv[])
+{
+    struct MallocHeap* heap = my_heap_create();
+    if (!heap || my_heap_reserve(heap, 4194304, 4) || !my_heap_reserve(heap, 4194304, MY_MALLOC_RESERVE_POPULATE))
+    {
+        return -1;
+    }
+
+    struct MallocStats stats = { 0 };
+    my_heap_stats(heap, &stats);
+    if (stats.num_mmap != 1 || stats.mapped < 4194304)
+    {
+        return -1;
+    }
+
+    for (size_t i = 0; i != NUM_ALLOCS; ++i)
+    {
+        ptrs[i] = my_heap_malloc(heap, i + 1);
+        if (!ptrs[i])
+        {
+            return -1;
+        }
+
+        memset(ptrs[i], (int)i, i + 1);
+    }
+
+    my_heap_stats(heap, &stats);
+    if (stats.num_mmap != 1)
+    {
+        return -1;
+    }
+
+    for (size_t i = 0; i != NUM_ALLOCS; ++i)
+    {
+        for (size_t j = 0; j != i + 1; ++j)
+        {
+            if (ptrs[i][j] != (char)i)
+            {
+                return -1;
+            }
+        }
+
+        my_heap_free(heap, ptrs[i]);
+    }
+
+    my_heap_destroy(heap);
+
+    // the heap of my_malloc
+    if (!my_malloc_reserve(1048576, 0))
+    {
+        return -1;
+    }
+
+    char* ptr = my_malloc(100);
+    if (!ptr)
+    {
+        return -1;
+    }
+    my_free(ptr);
+
+    return 0;
+}
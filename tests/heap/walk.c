@@ -0,0 +1,197 @@
+// walk a heap and check every allocation is seen
+// once, every block adds up and a dump is written,
+// then that a run of frees is seen merged
+
+#include <custom_mem/malloc.h>
+#include <string.h>
+#include <unistd.h>
+
+#define NUM_ALLOCS 500
+
+// allocations freed together, all in one block
+#define RUN_START 10
+#define RUN_END   20
+
+static char* ptrs[NUM_ALLOCS];
+
+struct Seen
+{
+    size_t mappings;
+    size_t blocks;
+    size_t in_use;
+    size_t found;
+
+    /*  Bytes of the block being walked not in
+        allocations, which is its meta data, and
+        what is in front of its first allocation.
+    */
+    const char* block;
+    size_t      left;
+    size_t      header;
+    int         bad;
+};
+
+static int count(const struct MallocWalkEntry* entry, void* ctx)
+{
+    struct Seen* seen = ctx;
+
+    switch (entry->kind)
+    {
+        case MY_MALLOC_WALK_MAPPING:
+            ++seen->mappings;
+            break;
+        case MY_MALLOC_WALK_BLOCK:
+            if (seen->blocks++)
+            {
+                seen->bad |= seen->left != seen->header;
+            }
+            seen->block = entry->addr;
+            seen->left = entry->sz;
+            seen->header = 0;
+            break;
+        case MY_MALLOC_WALK_ALLOC:
+            if (entry->in_use)
+            {
+                ++seen->in_use;
+                for (size_t i = 0; i != NUM_ALLOCS; ++i)
+                {
+                    if (ptrs[i] == entry->addr)
+                    {
+                        ++seen->found;
+                        seen->bad |= entry->sz != my_malloc_usable_size(ptrs[i]);
+                    }
+                }
+            }
+            seen->left -= entry->sz + (2 * sizeof(void*));
+            if (!seen->header)
+            {
+                seen->header = (const char*)entry->addr - (2 * sizeof(void*)) - seen->block;
+            }
+            break;
+    }
+
+    return 0;
+}
+
+struct Run
+{
+    // whether the last allocation seen was free
+    int    free;
+    int    adjacent;
+
+    // largest free allocation
+    size_t max;
+};
+
+static int runs(const struct MallocWalkEntry* entry, void* ctx)
+{
+    struct Run* run = ctx;
+
+    if (entry->kind != MY_MALLOC_WALK_ALLOC)
+    {
+        run->free = 0;
+
+        return 0;
+    }
+
+    run->adjacent |= run->free && !entry->in_use;
+    run->free = !entry->in_use;
+
+    if (!entry->in_use && entry->sz > run->max)
+    {
+        run->max = entry->sz;
+    }
+
+    return 0;
+}
+
+static int stop(const struct MallocWalkEntry* entry, void* ctx)
+{
+    return entry->kind == MY_MALLOC_WALK_BLOCK ? 7 : 0;
+}
+
+int main(int argc, char const *argv[])
+{
+    // frees merged as they are made
+    my_mallopt(MY_M_COALESCE, 0);
+
+    struct MallocHeap* heap = my_heap_create();
+
+    for (size_t i = 0; i != NUM_ALLOCS; ++i)
+    {
+        // one large allocation with a mapping to itself
+        ptrs[i] = my_heap_malloc(heap, i ? i * 3 : 200000);
+    }
+
+    for (size_t i = 0; i < NUM_ALLOCS; i += 3)
+    {
+        my_heap_free(heap, ptrs[i]);
+        ptrs[i] = NULL;
+    }
+
+    struct Seen seen = { 0 };
+    if (my_heap_walk(heap, count, &seen))
+    {
+        return -1;
+    }
+
+    // every block is its meta data and allocations
+    seen.bad |= seen.left != seen.header;
+
+    size_t in_use = NUM_ALLOCS - ((NUM_ALLOCS + 2) / 3);
+    if (seen.in_use != in_use || seen.found != in_use || seen.bad || seen.mappings < 1 || seen.blocks < seen.mappings)
+    {
+        return -1;
+    }
+
+    if (my_heap_walk(heap, stop, NULL) != 7)
+    {
+        return -1;
+    }
+
+    int fds[2];
+    if (pipe(fds))
+    {
+        return -1;
+    }
+
+    my_heap_dump(heap, fds[1]);
+    close(fds[1]);
+
+    char buf[256];
+    ssize_t len = read(fds[0], buf, sizeof(buf) - 1);
+    close(fds[0]);
+
+    if (len <= 0)
+    {
+        return -1;
+    }
+    buf[len] = 0;
+
+    if (!strstr(buf, "largest"))
+    {
+        return -1;
+    }
+
+    // merged by the block as freed, so seen as one
+    size_t run_sz = 0;
+    for (size_t i = RUN_START; i != RUN_END; ++i)
+    {
+        if (ptrs[i])
+        {
+            run_sz += my_malloc_usable_size(ptrs[i]) + (2 * sizeof(void*));
+            my_heap_free(heap, ptrs[i]);
+            ptrs[i] = NULL;
+        }
+    }
+
+    struct Run run = { 0 };
+    if (my_heap_walk(heap, runs, &run) || run.adjacent || run.max < run_sz - (2 * sizeof(void*)))
+    {
+        return -1;
+    }
+
+    my_heap_destroy(heap);
+
+    return 0;
+}
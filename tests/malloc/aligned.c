@@ -0,0 +1,60 @@
+// allocate small, mid and large sizes at every
+// alignment upto a page and check each is aligned,
+// usable and given back in full
+
+#include <custom_mem/malloc.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#define NUM_SIZES 5
+
+static const size_t sizes[NUM_SIZES] = { 1, 24, 1000, 100000, 1048576 };
+
+int main(int argc, char const *argv[])
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+
+    if (my_aligned_alloc(0, 8) || my_aligned_alloc(24, 8) || my_aligned_alloc(2 * page, 8))
+    {
+        return -1;
+    }
+
+    struct MallocHeap* heap = my_heap_create();
+
+    for (size_t align = 1; align <= page; align <<= 1)
+    {
+        for (size_t i = 0; i != NUM_SIZES; ++i)
+        {
+            char* ptr = my_aligned_alloc(align, sizes[i]);
+            char* on_heap = my_heap_aligned_alloc(heap, align, sizes[i]);
+
+            if (
+                !ptr || (uintptr_t)ptr % align || my_malloc_usable_size(ptr) < sizes[i] ||
+                !on_heap || (uintptr_t)on_heap % align
+            )
+            {
+                return -1;
+            }
+
+            memset(ptr, 1, sizes[i]);
+            memset(on_heap, 2, sizes[i]);
+
+            // still an allocation like any other
+            ptr = my_realloc(ptr, sizes[i] + 100);
+            if (!ptr || ptr[sizes[i] - 1] != 1)
+            {
+                return -1;
+            }
+
+            my_free(ptr);
+            my_heap_free(heap, on_heap);
+        }
+    }
+
+    struct MallocStats stats = { 0 };
+    my_heap_stats(heap, &stats);
+    my_heap_destroy(heap);
+
+    return stats.in_use ? -1 : 0;
+}
@@ -0,0 +1,50 @@
+// constant sized requests through the inline
+// path reuse freed allocations of their class
+
+#include <custom_mem/malloc.h>
+
+struct Node
+{
+    struct Node* next;
+    long         value;
+};
+
+int main(int argc, char const *argv[])
+{
+    if (my_malloc_size_class(1) != 0 || my_malloc_size_class(MY_MALLOC_SMALL_MAX + 1) != MY_MALLOC_NUM_CLASSES)
+    {
+        return -1;
+    }
+
+    struct Node* first = my_malloc_inline(sizeof(struct Node));
+    first->value = 1;
+    first->next  = NULL;
+
+    struct Node* second = my_malloc_inline(sizeof(struct Node));
+    if (second == first)
+    {
+        return -1;
+    }
+
+    my_free(second);
+
+    // most recently freed of the same class
+    struct Node* third = my_malloc_inline(sizeof(struct Node));
+    if (third != second)
+    {
+        return -1;
+    }
+
+    // different request in the same class
+    my_free(third);
+    char* bytes = my_malloc(sizeof(struct Node) - 1);
+    if ((void*)bytes != (void*)third)
+    {
+        return -1;
+    }
+
+    my_free(bytes);
+    my_free(first);
+
+    return 0;
+}
@@ -0,0 +1,75 @@
+// overrun an allocation into the meta data of the
+// free space after it and check the heap still
+// hands out space that does not overlap
+
+#include <custom_mem/malloc.h>
+#include <string.h>
+
+#define NUM_ALLOCS 32
+#define SZ         16
+
+int main(int argc, char const *argv[])
+{
+    struct MallocHeap* heap = my_heap_create();
+
+    char* a = my_heap_malloc(heap, 64);
+    char* b = my_heap_malloc(heap, 64);
+    char* c = my_heap_malloc(heap, 64);
+    if (!a || !b || !c)
+    {
+        return -1;
+    }
+    memset(c, 0x11, 64);
+
+    my_heap_free(heap, b);
+
+    // writes over the size and state of the free space
+    memset(a + 64, 0xab, 2 * sizeof(void*));
+
+    char* ptrs[NUM_ALLOCS];
+    for (size_t i = 0; i != NUM_ALLOCS; ++i)
+    {
+        ptrs[i] = my_heap_malloc(heap, SZ);
+        if (!ptrs[i] || (ptrs[i] < c + 64 && ptrs[i] + SZ > c) || (ptrs[i] < a + 64 && ptrs[i] + SZ > a))
+        {
+            return -1;
+        }
+        memset(ptrs[i], (int)i, SZ);
+    }
+
+    for (size_t i = 0; i != NUM_ALLOCS; ++i)
+    {
+        for (size_t j = 0; j != SZ; ++j)
+        {
+            if (ptrs[i][j] != (char)i)
+            {
+                return -1;
+            }
+        }
+    }
+
+    for (size_t j = 0; j != 64; ++j)
+    {
+        if (c[j] != 0x11)
+        {
+            return -1;
+        }
+    }
+
+    for (size_t i = 0; i != NUM_ALLOCS; ++i)
+    {
+        my_heap_free(heap, ptrs[i]);
+    }
+
+    struct MallocStats stats = { 0 };
+    my_heap_stats(heap, &stats);
+
+    if (stats.in_use != 128)
+    {
+        return -1;
+    }
+
+    my_heap_destroy(heap);
+
+    return 0;
+}
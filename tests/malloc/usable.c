@@ -0,0 +1,39 @@
+// every allocation has exactly the good size of
+// its request usable, and can grow to it in place
+
+#include <custom_mem/malloc.h>
+#include <string.h>
+
+int main(int argc, char const *argv[])
+{
+    if (my_malloc_usable_size(NULL))
+    {
+        return -1;
+    }
+
+    for (size_t bytes = 0; bytes < 1 << 20; bytes = bytes * 2 + 7)
+    {
+        size_t good = my_malloc_good_size(bytes);
+        if (good < bytes)
+        {
+            return -1;
+        }
+
+        char* res = my_malloc(bytes);
+        if (my_malloc_usable_size(res) != good)
+        {
+            return -1;
+        }
+
+        memset(res, 1, good);
+
+        if (my_realloc(res, good) != res)
+        {
+            return -1;
+        }
+
+        my_free(res);
+    }
+
+    return 0;
+}
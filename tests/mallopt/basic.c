@@ -0,0 +1,62 @@
+// set every adjustable and make sure allocations
+// on both sides of the changed limits still work
+
+#include <custom_mem/malloc.h>
+#include <string.h>
+
+int main(int argc, char const *argv[])
+{
+    if (my_mallopt(0, 1) || my_mallopt(MY_M_MORE_MEM, 1) || my_mallopt(MY_M_LARGE, 0))
+    {
+        return -1;
+    }
+
+    if
+    (
+        !my_mallopt(MY_M_MORE_MEM, 4194304)
+        ||
+        !my_mallopt(MY_M_SHORT_WAIT, 8)
+        ||
+        !my_mallopt(MY_M_LONG_WAIT, 1000)
+        ||
+        !my_mallopt(MY_M_LARGE, 8192)
+        ||
+        !my_mallopt(MY_M_TRIM, 4096)
+    )
+    {
+        return -1;
+    }
+
+    char* small = my_malloc(100);
+    char* mid   = my_malloc(6000);
+    char* large = my_malloc(10000);
+
+    memset(small, 1, 100);
+    memset(mid, 2, 6000);
+    memset(large, 3, 10000);
+
+    // moves mid to a large mapping
+    mid = my_realloc(mid, 9000);
+    for (int i = 0; i != 6000; ++i)
+    {
+        if (mid[i] != 2)
+        {
+            return -1;
+        }
+    }
+
+    my_free(large);
+    my_free(mid);
+
+    for (int i = 0; i != 100; ++i)
+    {
+        if (small[i] != 1)
+        {
+            return -1;
+        }
+    }
+
+    my_free(small);
+
+    return 0;
+}
@@ -0,0 +1,59 @@
+// more_mem must be whole pages, and mappings of any
+// such size are taken from the reserved range
+
+#include <custom_mem/malloc.h>
+#include <unistd.h> // sysconf
+
+#define RESERVE    16777216
+#define NUM_ALLOCS 200
+#define SZ         1000
+
+int main(int argc, char const *argv[])
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+
+    if
+    (
+        my_mallopt(MY_M_MORE_MEM, page + 904)
+        ||
+        my_mallopt(MY_M_MORE_MEM, (3 * page) - 1)
+        ||
+        !my_mallopt(MY_M_MORE_MEM, 3 * page)
+        ||
+        !my_mallopt(MY_M_GROW_MAX, 3 * page)
+        ||
+        !my_mallopt(MY_M_RESERVE, RESERVE)
+    )
+    {
+        return -1;
+    }
+
+    struct MallocHeap* heap = my_heap_create();
+
+    for (size_t i = 0; i != NUM_ALLOCS; ++i)
+    {
+        char* ptr = my_heap_malloc(heap, SZ);
+        if (!ptr)
+        {
+            return -1;
+        }
+        ptr[SZ - 1] = 1;
+
+        // only found without the heap through the range
+        if (my_heap_of(NULL, ptr) != heap)
+        {
+            return -1;
+        }
+    }
+
+    struct MallocStats stats;
+    my_heap_stats(heap, &stats);
+    if (stats.num_mmap < 2)
+    {
+        return -1;
+    }
+
+    my_heap_destroy(heap);
+
+    return 0;
+}
@@ -0,0 +1,97 @@
+// have threads fight over the blocks of one heap
+// and check the contention reported adds up
+
+#include <custom_mem/malloc.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define NUM_THREADS 4
+#define NUM_SLOTS   64
+#define NUM_CALLS   100000
+#define NUM_HOT     8
+
+static struct MallocHeap* heap;
+
+// threads free what others allocated
+static void* _Atomic slots[NUM_SLOTS];
+
+static void* work(void* arg)
+{
+    size_t seed = (size_t)arg;
+
+    for (size_t i = 0; i != NUM_CALLS; ++i)
+    {
+        seed = (seed * 6364136223846793005u) + 1442695040888963407u;
+
+        void* old = atomic_exchange(&slots[(seed >> 33) % NUM_SLOTS], my_heap_malloc(heap, 16 + ((seed >> 40) % 200)));
+        my_heap_free(heap, old);
+    }
+
+    return NULL;
+}
+
+int main(int argc, char const *argv[])
+{
+    heap = my_heap_create();
+
+    pthread_t threads[NUM_THREADS];
+    for (size_t i = 0; i != NUM_THREADS; ++i)
+    {
+        if (pthread_create(&threads[i], NULL, work, (void*)(i + 1)))
+        {
+            return -1;
+        }
+    }
+
+    for (size_t i = 0; i != NUM_THREADS; ++i)
+    {
+        if (pthread_join(threads[i], NULL))
+        {
+            return -1;
+        }
+    }
+
+    struct MallocStats stats = { 0 };
+    my_heap_stats(heap, &stats);
+
+    struct MallocHotBlock hot[NUM_HOT];
+    size_t found = my_heap_hot_blocks(heap, hot, NUM_HOT);
+
+    if (found > NUM_HOT || (!found && (stats.block_fails || stats.block_spins)))
+    {
+        return -1;
+    }
+
+    size_t fails = 0;
+    size_t spins = 0;
+    for (size_t i = 0; i != found; ++i)
+    {
+        if (!hot[i].block || !hot[i].sz || (i && hot[i - 1].fails + hot[i - 1].spins < hot[i].fails + hot[i].spins))
+        {
+            return -1;
+        }
+
+        fails += hot[i].fails;
+        spins += hot[i].spins;
+    }
+
+    if (fails > stats.block_fails || spins > stats.block_spins)
+    {
+        return -1;
+    }
+
+    // a single block is the hottest of one
+    if (found && (my_heap_hot_blocks(heap, hot, 1) != 1 || hot[0].fails + hot[0].spins < fails / found))
+    {
+        return -1;
+    }
+
+    for (size_t i = 0; i != NUM_SLOTS; ++i)
+    {
+        my_heap_free(heap, slots[i]);
+    }
+
+    my_heap_destroy(heap);
+
+    return 0;
+}
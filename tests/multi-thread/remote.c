@@ -0,0 +1,107 @@
+// have threads only free what other threads
+// allocated and check nothing is lost once
+// every free left for later is done
+
+#include <custom_mem/malloc.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#define NUM_PAIRS 2
+#define NUM_SLOTS 256
+#define NUM_CALLS 100000
+
+static struct MallocHeap* heap;
+
+static void* _Atomic slots[NUM_PAIRS][NUM_SLOTS];
+
+static atomic_int failed;
+
+static void* produce(void* arg)
+{
+    void* _Atomic* ring = slots[(size_t)arg];
+
+    for (size_t i = 0; i != NUM_CALLS; ++i)
+    {
+        size_t sz = 16 + (i % 100);
+        unsigned char* ptr = my_heap_malloc(heap, sz);
+        if (!ptr)
+        {
+            atomic_store(&failed, 1);
+            return NULL;
+        }
+        memset(ptr, (unsigned char)sz, sz);
+
+        // wait for the consumer to empty the slot
+        void* expected = NULL;
+        while (!atomic_compare_exchange_weak(&ring[i % NUM_SLOTS], &expected, ptr))
+        {
+            expected = NULL;
+        }
+    }
+
+    return NULL;
+}
+
+static void* consume(void* arg)
+{
+    void* _Atomic* ring = slots[(size_t)arg];
+
+    for (size_t i = 0; i != NUM_CALLS; ++i)
+    {
+        unsigned char* ptr;
+        while (!(ptr = atomic_exchange(&ring[i % NUM_SLOTS], NULL)));
+
+        size_t sz = 16 + (i % 100);
+        for (size_t j = 0; j != sz; ++j)
+        {
+            if (ptr[j] != (unsigned char)sz)
+            {
+                atomic_store(&failed, 1);
+            }
+        }
+
+        my_heap_free(heap, ptr);
+    }
+
+    return NULL;
+}
+
+int main(int argc, char const *argv[])
+{
+    heap = my_heap_create();
+
+    pthread_t threads[2 * NUM_PAIRS];
+    for (size_t i = 0; i != NUM_PAIRS; ++i)
+    {
+        if (
+            pthread_create(&threads[2 * i], NULL, produce, (void*)i) ||
+            pthread_create(&threads[(2 * i) + 1], NULL, consume, (void*)i)
+        )
+        {
+            return -1;
+        }
+    }
+
+    for (size_t i = 0; i != 2 * NUM_PAIRS; ++i)
+    {
+        if (pthread_join(threads[i], NULL))
+        {
+            return -1;
+        }
+    }
+
+    // locking every block for the stats frees
+    // whatever was left on their lists
+    struct MallocStats stats = { 0 };
+    my_heap_stats(heap, &stats);
+
+    if (failed || stats.in_use || stats.free_max == 0)
+    {
+        return -1;
+    }
+
+    my_heap_destroy(heap);
+
+    return 0;
+}
@@ -0,0 +1,110 @@
+// have threads allocate small objects side by side,
+// free them through their caches and allocate again,
+// and check no two threads share a cache line
+
+#include <custom_mem/malloc.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define NUM_THREADS 4
+#define NUM_CALLS   200
+#define LINE        64
+
+static uintptr_t first[NUM_THREADS][NUM_CALLS];
+static uintptr_t last[NUM_THREADS][NUM_CALLS];
+
+static pthread_barrier_t barrier;
+
+static atomic_int failed;
+
+static void* allocate(void* arg)
+{
+    size_t t = (size_t)arg;
+    char* ptrs[NUM_CALLS];
+
+    pthread_barrier_wait(&barrier);
+
+    for (size_t i = 0; i != NUM_CALLS; ++i)
+    {
+        ptrs[i] = my_malloc(8 + ((i * 8) % 64));
+    }
+
+    // more than the caches hold, what they can not
+    // must not reach another thread
+    for (size_t i = 0; i != NUM_CALLS; ++i)
+    {
+        my_free(ptrs[i]);
+    }
+
+    pthread_barrier_wait(&barrier);
+
+    for (size_t i = 0; i != NUM_CALLS; ++i)
+    {
+        size_t sz = 8 + ((i * 8) % 64);
+        char* ptr = my_malloc(sz);
+        if (!ptr)
+        {
+            atomic_store(&failed, 1);
+            break;
+        }
+
+        first[t][i] = (uintptr_t)ptr / LINE;
+        last[t][i] = ((uintptr_t)ptr + sz - 1) / LINE;
+    }
+
+    // blocks are given up on exit, so none may exit
+    // before all are done
+    pthread_barrier_wait(&barrier);
+
+    return NULL;
+}
+
+int main(int argc, char const *argv[])
+{
+    my_mallopt(MY_M_SEGREGATE, 1);
+    my_mallopt(MY_M_CACHE, 4);
+
+    pthread_barrier_init(&barrier, NULL, NUM_THREADS);
+
+    pthread_t threads[NUM_THREADS];
+    for (size_t t = 0; t != NUM_THREADS; ++t)
+    {
+        if (pthread_create(&threads[t], NULL, allocate, (void*)t))
+        {
+            return -1;
+        }
+    }
+
+    for (size_t t = 0; t != NUM_THREADS; ++t)
+    {
+        if (pthread_join(threads[t], NULL))
+        {
+            return -1;
+        }
+    }
+
+    if (failed)
+    {
+        return -1;
+    }
+
+    for (size_t a = 0; a != NUM_THREADS; ++a)
+    {
+        for (size_t b = a + 1; b != NUM_THREADS; ++b)
+        {
+            for (size_t i = 0; i != NUM_CALLS; ++i)
+            {
+                for (size_t j = 0; j != NUM_CALLS; ++j)
+                {
+                    if (first[a][i] <= last[b][j] && first[b][j] <= last[a][i])
+                    {
+                        return -1;
+                    }
+                }
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,112 @@
+// free on one thread, allocate on another and
+// check the allocations move between them in
+// batches through the transfer cache
+
+#include <custom_mem/malloc.h>
+#include <pthread.h>
+
+#define NUM_ALLOCS 200
+#define SZ         64
+
+// half the default thread cache
+#define BATCH 16
+
+static void* ptrs[NUM_ALLOCS];
+
+static void* release(void* arg)
+{
+    for (size_t i = 0; i != NUM_ALLOCS; ++i)
+    {
+        my_free(ptrs[i]);
+    }
+
+    return NULL;
+}
+
+static void* take(void* arg)
+{
+    // every allocation should be one freed before
+
+    size_t* found = arg;
+
+    for (size_t i = 0; i != NUM_ALLOCS / BATCH * BATCH; ++i)
+    {
+        void* ptr = my_malloc(SZ);
+        for (size_t j = 0; j != NUM_ALLOCS; ++j)
+        {
+            if (ptr == ptrs[j])
+            {
+                ++*found;
+                break;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static int run(void* (*fn)(void*), void* arg)
+{
+    pthread_t thread;
+
+    return pthread_create(&thread, NULL, fn, arg) || pthread_join(thread, NULL);
+}
+
+static size_t transfer()
+{
+    struct MallocStats stats = { 0 };
+    my_heap_stats(NULL, &stats);
+
+    return stats.transfer;
+}
+
+int main(int argc, char const *argv[])
+{
+    if (my_mallopt(MY_M_TRANSFER, 65))
+    {
+        return -1;
+    }
+
+    // otherwise frees go back to the main thread's
+    // blocks, which it owns
+    my_mallopt(MY_M_SEGREGATE, 0);
+
+    // sampled allocations are never cached
+    my_mallopt(MY_M_GUARD_RATE, 0);
+
+    for (size_t i = 0; i != NUM_ALLOCS; ++i)
+    {
+        ptrs[i] = my_malloc(SZ);
+    }
+
+    // every whole batch goes to the transfer cache,
+    // even the ones left in the cache on exit
+    if (run(release, NULL) || transfer() != NUM_ALLOCS / BATCH * BATCH * SZ)
+    {
+        return -1;
+    }
+
+    size_t found = 0;
+    if (run(take, &found) || found != NUM_ALLOCS / BATCH * BATCH || transfer())
+    {
+        return -1;
+    }
+
+    // nothing is kept when disabled
+    if (!my_mallopt(MY_M_TRANSFER, 0))
+    {
+        return -1;
+    }
+
+    for (size_t i = 0; i != NUM_ALLOCS; ++i)
+    {
+        ptrs[i] = my_malloc(SZ);
+    }
+
+    if (run(release, NULL) || transfer())
+    {
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,60 @@
+// fill a pool across several runs, then check
+// alignment, reuse and that objects don't overlap
+
+#include <custom_mem/malloc.h>
+#include <stdint.h>
+
+#define NUM_OBJS 100000
+
+struct Session
+{
+    size_t id;
+    char   name[40];
+};
+
+static struct Session* objs[NUM_OBJS];
+
+int main(int argc, char const *argv[])
+{
+    if (my_pool_create(16, 3) || my_pool_create(16, 0))
+    {
+        return -1;
+    }
+
+    struct MallocPool* pool = my_pool_create(sizeof(struct Session), 64);
+    if (!pool)
+    {
+        return -1;
+    }
+
+    for (size_t i = 0; i != NUM_OBJS; ++i)
+    {
+        objs[i] = my_pool_alloc(pool);
+        if (!objs[i] || (uintptr_t)objs[i] % 64)
+        {
+            return -1;
+        }
+
+        objs[i]->id = i;
+    }
+
+    for (size_t i = 0; i != NUM_OBJS; ++i)
+    {
+        if (objs[i]->id != i)
+        {
+            return -1;
+        }
+    }
+
+    my_pool_free(pool, objs[10]);
+    my_pool_free(pool, objs[20]);
+
+    if (my_pool_alloc(pool) != objs[20] || my_pool_alloc(pool) != objs[10])
+    {
+        return -1;
+    }
+
+    my_pool_destroy(pool);
+
+    return 0;
+}
@@ -0,0 +1,96 @@
+// time operations from two threads, one after the
+// other, and check every call is counted once
+
+#include <custom_mem/malloc.h>
+#include <pthread.h>
+
+#define NUM_CALLS 1000
+
+static void* work(void* unused)
+{
+    for (size_t i = 0; i != NUM_CALLS; ++i)
+    {
+        char* ptr = my_malloc(i + 1);
+        ptr = my_realloc(ptr, i + 100);
+        my_free(ptr);
+        my_free(my_calloc(i + 1, 2));
+    }
+
+    return NULL;
+}
+
+static int check(int kind, size_t count)
+{
+    // return 0 if kind has count timings in order
+
+    struct MallocLatency lat;
+    my_malloc_latency(kind, &lat);
+
+    if
+    (
+        lat.count != count
+        ||
+        (count && !lat.max)
+        ||
+        lat.p50 > lat.p99 || lat.p99 > lat.p999 || lat.p999 > lat.max
+    )
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char const *argv[])
+{
+    // nothing recorded while off
+    work(NULL);
+    if (check(MY_MALLOC_LAT_MALLOC, 0) || !my_mallopt(MY_M_PROFILE, 1))
+    {
+        return -1;
+    }
+
+    // second thread takes over the first's histograms
+    for (size_t i = 0; i != 2; ++i)
+    {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, work, NULL) || pthread_join(thread, NULL))
+        {
+            return -1;
+        }
+    }
+
+    if
+    (
+        check(MY_MALLOC_LAT_MALLOC, 2 * NUM_CALLS)
+        ||
+        check(MY_MALLOC_LAT_FREE, 4 * NUM_CALLS)
+        ||
+        check(MY_MALLOC_LAT_CALLOC, 2 * NUM_CALLS)
+        ||
+        check(MY_MALLOC_LAT_REALLOC, 2 * NUM_CALLS)
+    )
+    {
+        return -1;
+    }
+
+    // large enough for a mapping of its own
+    my_free(my_malloc(1048576));
+
+    struct MallocLatency lat;
+    my_malloc_latency(MY_MALLOC_LAT_MMAP, &lat);
+    if (lat.count < 2)
+    {
+        return -1;
+    }
+
+    my_malloc_latency_reset();
+    if (check(MY_MALLOC_LAT_MALLOC, 0) || check(MY_MALLOC_LAT_MMAP, 0))
+    {
+        return -1;
+    }
+
+    my_malloc_latency(MY_MALLOC_LAT_KINDS, &lat);
+
+    return lat.count ? -1 : 0;
+}
@@ -0,0 +1,42 @@
+// request a few small sizes while profiling and
+// check the dump counts each once
+
+#include <custom_mem/malloc.h>
+#include <stdio.h>
+#include <string.h>
+
+int main(int argc, char const *argv[])
+{
+    if (!my_mallopt(MY_M_PROFILE, 1))
+    {
+        return -1;
+    }
+    my_malloc_latency_reset();
+
+    for (size_t i = 0; i != 100; ++i)
+    {
+        my_free(my_malloc(24));
+    }
+    for (size_t i = 0; i != 50; ++i)
+    {
+        my_free(my_calloc(10, 10));
+    }
+
+    // large requests are not small
+    my_free(my_malloc(1048576));
+
+    FILE* file = tmpfile();
+    if (!file)
+    {
+        return -1;
+    }
+
+    my_malloc_size_dump(fileno(file));
+    rewind(file);
+
+    char dump[256] = { 0 };
+    fread(dump, 1, sizeof(dump) - 1, file);
+    fclose(file);
+
+    return strcmp(dump, "# size count\n24 100\n104 50\n") ? -1 : 0;
+}
@@ -0,0 +1,240 @@
+// have a child process publish its statistics, check
+// they agree with my_heap_stats, read them from the
+// parent as another process would, then check the
+// segment is removed when the child exits
+
+#include <custom_mem/malloc.h>
+#include <errno.h>
+#include <fcntl.h>    // O_RDONLY
+#include <stdio.h>    // snprintf
+#include <string.h>
+#include <sys/mman.h> // shm_open
+#include <sys/wait.h> // waitpid
+#include <time.h>
+#include <unistd.h>   // fork, pipe
+
+#define SZ 65536
+
+#define NUM_SMALL 64
+
+// most waits of 10ms for the child
+#define MAX_WAITS 200
+
+static const struct MallocShared* attach(const char* name)
+{
+    struct timespec wait = { 0, 10000000 };
+
+    for (size_t i = 0; i != MAX_WAITS; ++i)
+    {
+        int fd = shm_open(name, O_RDONLY, 0);
+        if (fd != -1)
+        {
+            const struct MallocShared* shared = mmap(NULL, sizeof(struct MallocShared), PROT_READ, MAP_SHARED, fd, 0);
+            close(fd);
+
+            return shared == MAP_FAILED ? NULL : shared;
+        }
+
+        nanosleep(&wait, NULL);
+    }
+
+    return NULL;
+}
+
+static void read_shared(const struct MallocShared* shared, struct MallocShared* copy)
+{
+    for (;;)
+    {
+        size_t seq = __atomic_load_n(&shared->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1)
+        {
+            continue;
+        }
+
+        memcpy(copy, shared, sizeof(*copy));
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&shared->seq, __ATOMIC_RELAXED) == seq)
+        {
+            return;
+        }
+    }
+}
+
+static int agrees()
+{
+    // wait for a write made after this process stopped
+    // allocating and compare it with my_heap_stats
+    // return 1 if they agree
+
+    char name[64];
+    snprintf(name, sizeof(name), MY_MALLOC_SHARED_NAME, (long)getpid());
+
+    const struct MallocShared* shared = attach(name);
+    if (!shared)
+    {
+        return 0;
+    }
+
+    struct timespec wait = { 0, 10000000 };
+
+    struct MallocShared copy;
+    read_shared(shared, &copy);
+
+    // the next write may have started before
+    size_t updates = copy.updates + 2;
+
+    for (size_t i = 0; copy.updates < updates; ++i)
+    {
+        if (i == MAX_WAITS)
+        {
+            return 0;
+        }
+
+        nanosleep(&wait, NULL);
+        read_shared(shared, &copy);
+    }
+
+    struct MallocStats stats;
+    my_heap_stats(NULL, &stats);
+
+    return
+        copy.stats.in_use == stats.in_use
+        &&
+        copy.stats.free >= stats.free
+        &&
+        copy.stats.free_max == stats.free_max
+        &&
+        copy.stats.mapped == stats.mapped
+        &&
+        copy.stats.num_mmap == stats.num_mmap
+        &&
+        copy.stats.num_munmap == stats.num_munmap
+        &&
+        copy.stats.transfer == stats.transfer;
+}
+
+static int child(int done)
+{
+    if (!my_mallopt(MY_M_PUBLISH, 10))
+    {
+        return -1;
+    }
+
+    char* ptr = my_malloc(SZ);
+    memset(ptr, 1, SZ);
+
+    // every way an allocation changes what is in use
+
+    void* small[NUM_SMALL];
+    for (size_t i = 0; i != NUM_SMALL; ++i)
+    {
+        small[i] = my_malloc(24 + (i * 40));
+    }
+    for (size_t i = 0; i < NUM_SMALL; i += 2)
+    {
+        my_free(small[i]);
+    }
+
+    void* aligned = my_aligned_alloc(256, 3000);
+    char* grown = my_realloc(my_malloc(100), 400);
+    char* shrunk = my_realloc(my_malloc(2000), 50);
+    char* large = my_realloc(my_malloc(300000), 250000);
+    my_free(my_malloc(400000));
+
+    if (!aligned || !grown || !shrunk || !large || !agrees())
+    {
+        return -1;
+    }
+
+    // kept until the parent has seen it
+    char c;
+    if (read(done, &c, 1) != 1)
+    {
+        return -1;
+    }
+
+    my_free(ptr);
+
+    return 0;
+}
+
+static int seen(const struct MallocShared* shared, pid_t pid)
+{
+    // wait for a write showing the child's allocation
+    // return 1 if seen
+
+    struct timespec wait = { 0, 10000000 };
+
+    for (size_t i = 0; i != MAX_WAITS; ++i)
+    {
+        struct MallocShared copy;
+        read_shared(shared, &copy);
+
+        if
+        (
+            copy.magic == MY_MALLOC_SHARED_MAGIC
+            &&
+            copy.updates
+            &&
+            copy.stats.in_use >= SZ
+            &&
+            copy.stats.mapped >= copy.stats.in_use
+            &&
+            copy.stats.num_mmap
+        )
+        {
+            return copy.version == MY_MALLOC_SHARED_VERSION && copy.pid == pid && copy.num_classes == MY_MALLOC_NUM_CLASSES;
+        }
+
+        nanosleep(&wait, NULL);
+    }
+
+    return 0;
+}
+
+int main(int argc, char const *argv[])
+{
+    int done[2];
+    if (pipe(done))
+    {
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        return -1;
+    }
+    if (!pid)
+    {
+        close(done[1]);
+        return child(done[0]);
+    }
+    close(done[0]);
+
+    char name[64];
+    snprintf(name, sizeof(name), MY_MALLOC_SHARED_NAME, (long)pid);
+
+    const struct MallocShared* shared = attach(name);
+    int res = shared && seen(shared, pid);
+
+    if (write(done[1], "", 1) != 1)
+    {
+        return -1;
+    }
+
+    int status;
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status))
+    {
+        return -1;
+    }
+
+    // removed on exit
+    if (shm_open(name, O_RDONLY, 0) != -1 || errno != ENOENT)
+    {
+        return -1;
+    }
+
+    return res ? 0 : -1;
+}
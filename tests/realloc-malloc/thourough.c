@@ -30,102 +30,138 @@ void check_dupe()
     }
 }
 
+size_t node_bytes(size_t num_numbers)
+{
+    // bytes of the node holding num_numbers, never 0
+
+    size_t bytes = num_numbers ? num_numbers * sizeof(size_t) : 1;
+
+    return (bytes + MY_MALLOC_MIN_ALIGN - 1) & ~(MY_MALLOC_MIN_ALIGN - 1);
+}
+
+static int find_alloc(const struct MallocWalkEntry* entry, void* ctx)
+{
+    // stop at the allocation at ctx, returning whether its in use
+
+    if (entry->kind == MY_MALLOC_WALK_ALLOC && entry->addr == ctx)
+    {
+        return entry->in_use ? 1 : -1;
+    }
+
+    return 0;
+}
+
 void check_meta(int index)
 {
     /*  Check meta data for this particular allocation.
 
-        Meta data consists of (size_t,void*) in this order.
-            size_t - size of allocation
-            void*  - start of block, NULL if free
+        Its usable size must be the node holding its
+        numbers, and the heap must have it in use.
     */
 
-    size_t alloced_sz = *(size_t*)(addresses[index] - 16);
-    if (alloced_sz != number_at[index] * sizeof(size_t))
+    if (my_malloc_usable_size(addresses[index]) != node_bytes(number_at[index]))
     {
         fprintf(stderr, "Different number of bytes.\n");
         abort();
     }
 
-    char* block = *(void**)(addresses[index] - 8); 
-    if (!block)
+    if (my_heap_walk(NULL, find_alloc, addresses[index]) != 1)
     {
         fprintf(stderr, "Allocation is set to free.\n");
         abort();
     }
 }
 
-void check_block(int index)
+struct Walked
 {
-    /*  Check the block which is associated with the address
-        at index is still intact and correct.
-        ie
-            Every allocation contains the correct number of
-            numbers set to the correct value, and the meta
-            data is correct for each allocation.
-            The block is still the correct size according
-            to meta data.
-    */
-    
-    char* curr_ptr = *(void**)(addresses[index] - 8);
-    size_t block_sz = *(size_t*)(curr_ptr + 8);
-    curr_ptr += 40;
-    // curr_sz should land exactly at end of block
-    for (size_t curr_sz = 40; curr_sz != block_sz;) 
-    {
-        size_t sz = *(size_t*)curr_ptr; // sz can be 0
+    char* block_end; // end of the current block
+    char* alloc_end; // end of the last allocation in it
+};
 
-        // is the current allocation taken
-        if (*(void**)(curr_ptr + 8))
-        {
-            size_t num_numbers = sz / sizeof(size_t);
+static int check_alloc(const struct MallocWalkEntry* entry, void* ctx)
+{
+    struct Walked* walked = ctx;
 
-            /*  If the meta data for size of the allocation
-                is correct, then it will be stored.
+    if (entry->kind == MY_MALLOC_WALK_BLOCK)
+    {
+        walked->block_end = (char*)entry->addr + entry->sz;
+        walked->alloc_end = entry->addr;
+        return 0;
+    }
 
-                Can have multiple values in "number_at" be
-                the same. To make sure its the element
-                we're looking for check against the address.
-            */
-            int matched_index = 0;
-            for (; matched_index != 65; ++matched_index)
-            {
-                if
-                (
-                    number_at[matched_index] == num_numbers
-                    &&
-                    addresses[matched_index] - 16 == curr_ptr
-                )
-                {
-                    break;
-                }
-            }
+    if (entry->kind != MY_MALLOC_WALK_ALLOC)
+    {
+        return 0;
+    }
 
-            if (matched_index == 65)
-            {
-                fprintf(stderr, "Could not find corresponding number of numbers.\n");
-                abort();
-            }
+    // allocations follow each other within their block
+    char* addr = entry->addr;
+    if (addr < walked->alloc_end || addr + entry->sz > walked->block_end)
+    {
+        fprintf(stderr, "Allocation outside of its block.\n");
+        abort();
+    }
+    walked->alloc_end = addr + entry->sz;
 
-            curr_ptr += 16;
-            for (size_t curr_num = 0; curr_num != number_at[matched_index]; ++curr_num)
-            {
-                if (*(size_t*)curr_ptr != number_at[matched_index])
-                {
-                    fprintf(stderr, "Mismatch.\n");
-                    abort();
-                }
+    if (!entry->in_use)
+    {
+        return 0;
+    }
 
-                curr_ptr += sizeof(size_t);
-            }
+    /*  If the size of the allocation is correct,
+        then it will be stored.
 
-        }
-        else
+        Can have multiple values in "number_at" be
+        the same. To make sure its the element
+        we're looking for check against the address.
+    */
+    int matched_index = 0;
+    for (; matched_index != 65; ++matched_index)
+    {
+        if
+        (
+            node_bytes(number_at[matched_index]) == entry->sz
+            &&
+            addresses[matched_index] == addr
+        )
         {
-            curr_ptr += 16 + sz;
+            break;
         }
+    }
 
-        curr_sz += 16 + sz;
+    if (matched_index == 65)
+    {
+        fprintf(stderr, "Could not find corresponding number of numbers.\n");
+        abort();
     }
+
+    for (size_t curr_num = 0; curr_num != number_at[matched_index]; ++curr_num)
+    {
+        if (((size_t*)addr)[curr_num] != number_at[matched_index])
+        {
+            fprintf(stderr, "Mismatch.\n");
+            abort();
+        }
+    }
+
+    return 0;
+}
+
+void check_block(int index)
+{
+    /*  Check every block is still intact and correct,
+        by walking the heap.
+        ie
+            Every allocation contains the correct number of
+            numbers set to the correct value, and its size
+            is correct.
+            Allocations lie one after another within the
+            bounds of their block.
+    */
+
+    struct Walked walked = { NULL, NULL };
+
+    my_heap_walk(NULL, check_alloc, &walked);
 }
 
 void check_all()
@@ -143,12 +179,6 @@ void check_all()
                     abort();
                 }
             }
-
-            if (*(size_t*)(addr + (number_at[i] * sizeof(size_t))) == number_at[i])
-            {
-                fprintf(stderr, "Match.\n");
-                abort();
-            }
         }
     }
 }
@@ -158,6 +188,11 @@ void check_all()
 
 int main(int argc, char const *argv[])
 {
+    // cached allocations are rounded to their size class,
+    // sampled ones are not in any block
+    my_mallopt(MY_M_CACHE, 0);
+    my_mallopt(MY_M_GUARD_RATE, 0);
+
     for (int i = 0; i != NUM_CALLS; ++i)
     {
         check_dupe(i);        
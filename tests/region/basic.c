@@ -0,0 +1,75 @@
+// fill a region past one run with small and large
+// allocations, reset it and fill it again
+
+#include <custom_mem/malloc.h>
+#include <stdint.h>
+#include <string.h>
+
+#define NUM_ALLOCS 20000
+
+static char* allocs[NUM_ALLOCS];
+
+static int fill(struct MallocRegion* region, char value)
+{
+    for (size_t i = 0; i != NUM_ALLOCS; ++i)
+    {
+        // every 1000th allocation is large
+        size_t bytes = i % 1000 ? i % 200 + 1 : 300000;
+
+        allocs[i] = my_region_alloc(region, bytes);
+        if (!allocs[i] || (uintptr_t)allocs[i] % _Alignof(max_align_t))
+        {
+            return -1;
+        }
+
+        memset(allocs[i], value, bytes);
+    }
+
+    for (size_t i = 0; i != NUM_ALLOCS; ++i)
+    {
+        size_t bytes = i % 1000 ? i % 200 + 1 : 300000;
+
+        for (size_t j = 0; j != bytes; ++j)
+        {
+            if (allocs[i][j] != value)
+            {
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char const *argv[])
+{
+    struct MallocRegion* region = my_region_create();
+    if (!region)
+    {
+        return -1;
+    }
+
+    if (fill(region, 1))
+    {
+        return -1;
+    }
+
+    char* first = allocs[1];
+
+    my_region_reset(region);
+
+    if (fill(region, 2))
+    {
+        return -1;
+    }
+
+    // rewound to the same memory
+    if (allocs[1] != first)
+    {
+        return -1;
+    }
+
+    my_region_destroy(region);
+
+    return 0;
+}
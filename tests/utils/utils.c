@@ -1,28 +1,8 @@
+#include <custom_mem/malloc.h>
 #include <stdio.h>  // fprintf
 #include <stdlib.h> // abort
 
-/*  The following MUST be manually set using
-    malloc.c info to reflect correct values,
-*/
-struct MallocBlock
-{
-    size_t max_free;
-    size_t sz;
-    char   is_free;
-    void*  next;
-    void*  max_free_ptr;
-};
-
-#define BLOCK_META_DATA_SZ \
-    sizeof(struct MallocBlock)
-
-#define MY_MALLOC_ALLOC_META \
-    (sizeof(size_t) + sizeof(void*))
-
-#define MY_MALLOC_GET_SIZE(VP_META) \
-    (*(size_t*)(VP_META))
-
-void check_dupe(char* arr, size_t arr_sz)
+void check_dupe(char** arr, size_t arr_sz)
 {
     for (int j = 0; j != arr_sz; ++j)
     {
@@ -37,89 +17,76 @@ void check_dupe(char* arr, size_t arr_sz)
     }
 }
 
-void check_meta(char* addrs, size_t* vals, size_t index)
+void check_meta(char** addrs, size_t* vals, size_t index)
 {
-    size_t alloced_sz = *(size_t*)(addrs[index] - MY_MALLOC_ALLOC_META);
-    if (alloced_sz != vals[index] * sizeof(size_t))
+    if (my_malloc_usable_size(addrs[index]) != vals[index] * sizeof(size_t))
     {
         fprintf(stderr, "Different number of bytes.\n");
         abort();
     }
-
-    char* block = *(void**)(addrs[index] - 8); 
-    if (!block)
-    {
-        fprintf(stderr, "Allocation is set to free.\n");
-        abort();
-    }
 }
 
-void check_block(char* addrs, size_t* vals, size_t index, size_t arr_sz)
+struct Checked
 {
-    // get block ptr
-    char* curr_ptr = *(void**)(addrs[index] - 8);
-    size_t block_sz = *(size_t*)(curr_ptr + 8);
-    curr_ptr += BLOCK_META_DATA_SZ;
-    // curr_sz should land exactly at end of block
-    for (size_t curr_sz = BLOCK_META_DATA_SZ; curr_sz != block_sz;) 
-    {
-        size_t sz = *(size_t*)curr_ptr; // sz can be 0
-
-        // is the current allocation taken
-        if (*(void**)(curr_ptr + 8))
-        {
-            size_t num_numbers = sz / sizeof(size_t);
+    char**  addrs;
+    size_t* vals;
+    size_t  arr_sz;
+};
 
-            /*  If the meta data for size of the allocation
-                is correct, then it will be stored.
+static int check_alloc(const struct MallocWalkEntry* entry, void* ctx)
+{
+    struct Checked* checked = ctx;
 
-                Can have multiple values in "vals" be
-                the same. To make sure its the element
-                we're looking for check against the address.
-            */
-            int matched_index = 0;
-            for (; matched_index != arr_sz; ++matched_index)
-            {
-                if
-                (
-                    vals[matched_index] == num_numbers
-                    &&
-                    addrs[matched_index] - MY_MALLOC_ALLOC_META == curr_ptr
-                )
-                {
-                    break;
-                }
-            }
+    if (entry->kind != MY_MALLOC_WALK_ALLOC || !entry->in_use)
+    {
+        return 0;
+    }
 
-            if (matched_index == arr_sz)
-            {
-                fprintf(stderr, "Could not find corresponding number of numbers.\n");
-                abort();
-            }
+    /*  Can have multiple values in "vals" be
+        the same. To make sure its the element
+        we're looking for check against the address.
+    */
+    size_t matched_index = 0;
+    for (; matched_index != checked->arr_sz; ++matched_index)
+    {
+        if (checked->addrs[matched_index] == entry->addr)
+        {
+            break;
+        }
+    }
 
-            curr_ptr += MY_MALLOC_ALLOC_META;
-            for (size_t curr_num = 0; curr_num != vals[matched_index]; ++curr_num)
-            {
-                if (*(size_t*)curr_ptr != vals[matched_index])
-                {
-                    fprintf(stderr, "Mismatch.\n");
-                    abort();
-                }
+    if (matched_index == checked->arr_sz)
+    {
+        // allocated by something other than the test
+        return 0;
+    }
 
-                curr_ptr += sizeof(size_t);
-            }
+    if (entry->sz != checked->vals[matched_index] * sizeof(size_t))
+    {
+        fprintf(stderr, "Could not find corresponding number of numbers.\n");
+        abort();
+    }
 
-        }
-        else
+    for (size_t curr_num = 0; curr_num != checked->vals[matched_index]; ++curr_num)
+    {
+        if (((size_t*)entry->addr)[curr_num] != checked->vals[matched_index])
         {
-            curr_ptr += MY_MALLOC_ALLOC_META + sz;
+            fprintf(stderr, "Mismatch.\n");
+            abort();
         }
-
-        curr_sz += MY_MALLOC_ALLOC_META + sz;
     }
+
+    return 0;
+}
+
+void check_block(char** addrs, size_t* vals, size_t arr_sz)
+{
+    struct Checked checked = { addrs, vals, arr_sz };
+
+    my_heap_walk(NULL, check_alloc, &checked);
 }
 
-void check_all(char* addrs, size_t* vals, size_t arr_sz)
+void check_all(char** addrs, size_t* vals, size_t arr_sz)
 {
     for (int i = 0; i != arr_sz; ++i)
     {
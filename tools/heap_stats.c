@@ -0,0 +1,183 @@
+// print the statistics another process publishes to
+// shared memory with MY_M_PUBLISH set, without
+// stopping or calling into it
+//
+//     build/tools/heap_stats [-i ms] [-n count] [-c] pid
+//
+//     -i  milliseconds between prints, 1000 by default
+//     -n  prints before stopping, 0 to print until the
+//         process exits, the default
+//     -c  also print the size classes
+//
+// Only reads the segment, so it must be built with the
+// same custom_mem/malloc.h as the process.
+
+#include <custom_mem/malloc.h>
+#include <errno.h>
+#include <fcntl.h>    // O_RDONLY
+#include <signal.h>   // kill
+#include <stdio.h>    // printf
+#include <stdlib.h>   // strtoull
+#include <string.h>   // memcpy
+#include <sys/mman.h> // shm_open, mmap
+#include <time.h>     // nanosleep
+#include <unistd.h>   // getopt
+
+static int usage(const char* name)
+{
+    fprintf(stderr, "usage: %s [-i ms] [-n count] [-c] pid\n", name);
+
+    return 1;
+}
+
+static void read_shared(const struct MallocShared* shared, struct MallocShared* copy)
+{
+    // copy shared into copy once it is not being
+    // written during the copy
+
+    for (;;)
+    {
+        size_t seq = __atomic_load_n(&shared->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1)
+        {
+            continue;
+        }
+
+        memcpy(copy, shared, sizeof(*copy));
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&shared->seq, __ATOMIC_RELAXED) == seq)
+        {
+            return;
+        }
+    }
+}
+
+static void print_shared(const struct MallocShared* shared, int classes)
+{
+    const struct MallocStats* stats = &shared->stats;
+
+    printf("pid %ld update %zu time %zu.%09zu\n", shared->pid, shared->updates, shared->time_ns / 1000000000, shared->time_ns % 1000000000);
+    printf("    mapped         %zu\n", stats->mapped);
+    printf("    in_use         %zu\n", stats->in_use);
+    printf("    free           %zu\n", stats->free);
+    printf("    free_max       %zu\n", stats->free_max);
+    printf("    transfer       %zu\n", stats->transfer);
+    printf("    purged         %zu\n", stats->purged);
+    printf("    block_fails    %zu\n", stats->block_fails);
+    printf("    block_spins    %zu\n", stats->block_spins);
+    printf("    block_deferred %zu\n", stats->block_deferred);
+    printf("    block_pending  %zu\n", stats->block_pending);
+    printf("    heap_fails     %zu\n", stats->heap_fails);
+    printf("    num_mmap       %zu\n", stats->num_mmap);
+    printf("    num_munmap     %zu\n", stats->num_munmap);
+
+    if (classes)
+    {
+        printf("    class size requests transfer\n");
+
+        for (size_t i = 0; i != shared->num_classes; ++i)
+        {
+            printf("    %5zu %4zu %8zu %8zu\n", i, shared->class_sz[i], shared->class_requests[i], shared->class_transfer[i]);
+        }
+    }
+
+    fflush(stdout);
+}
+
+int main(int argc, char* argv[])
+{
+    size_t interval = 1000;
+    size_t count    = 0;
+    int    classes  = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "i:n:c")) != -1)
+    {
+        switch (opt)
+        {
+            case 'i':
+                interval = strtoull(optarg, NULL, 0);
+                break;
+            case 'n':
+                count = strtoull(optarg, NULL, 0);
+                break;
+            case 'c':
+                classes = 1;
+                break;
+            default:
+                return usage(argv[0]);
+        }
+    }
+
+    if (optind + 1 != argc)
+    {
+        return usage(argv[0]);
+    }
+
+    long pid = strtol(argv[optind], NULL, 0);
+
+    char name[64];
+    snprintf(name, sizeof(name), MY_MALLOC_SHARED_NAME, pid);
+
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd == -1)
+    {
+        perror(name);
+        return 1;
+    }
+
+    const struct MallocShared* shared = mmap(NULL, sizeof(struct MallocShared), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shared == MAP_FAILED)
+    {
+        perror(name);
+        return 1;
+    }
+
+    struct timespec wait =
+    {
+        interval / 1000,
+        (interval % 1000) * 1000000
+    };
+
+    // the segment is made before its first write
+
+    while (__atomic_load_n(&shared->magic, __ATOMIC_ACQUIRE) != MY_MALLOC_SHARED_MAGIC)
+    {
+        if (kill(pid, 0) && errno == ESRCH)
+        {
+            fprintf(stderr, "%s: left unfinished by %ld\n", name, pid);
+            return 1;
+        }
+
+        nanosleep(&wait, NULL);
+    }
+
+    if (shared->version != MY_MALLOC_SHARED_VERSION || shared->num_classes != MY_MALLOC_NUM_CLASSES)
+    {
+        fprintf(stderr, "%s: written by another version of custom_mem/malloc.h\n", name);
+        return 1;
+    }
+
+    for (size_t i = 0; !count || i != count; ++i)
+    {
+        if (i)
+        {
+            nanosleep(&wait, NULL);
+        }
+
+        // what is left after it exits was already printed
+        if (kill(pid, 0) && errno == ESRCH)
+        {
+            break;
+        }
+
+        struct MallocShared copy;
+        read_shared(shared, &copy);
+
+        print_shared(&copy, classes);
+    }
+
+    return 0;
+}
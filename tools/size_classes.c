@@ -0,0 +1,259 @@
+// choose the size classes which waste the fewest bytes
+// on a histogram of allocation sizes, and write them
+// as a custom_mem/size_classes.h
+//
+//     build/tools/size_classes [-n classes] [-p page] [-a align] [-o out] [histogram]
+//
+//     -n  number of classes, atmost the number of sizes seen
+//     -p  page size, larger sizes are not small and are skipped
+//     -a  every class is a multiple of this, itself a multiple of
+//         MY_MALLOC_MIN_ALIGN, which is the default
+//     -o  header to write, stdout by default
+//
+// The histogram, stdin by default, has a "size count" per
+// line, as written by my_malloc_size_dump, or one size per
+// line, as in a trace. Lines starting with # are skipped.
+//
+// Build with the header by passing SIZE_CLASSES=out to make.
+
+#include <custom_mem/malloc.h>
+#include <stdint.h>
+#include <stdio.h>  // fopen, fprintf
+#include <stdlib.h> // calloc, strtoull
+#include <unistd.h> // getopt
+
+static size_t num_classes = 20;
+static size_t page        = 4096;
+static size_t align       = MY_MALLOC_MIN_ALIGN;
+
+static int usage(const char* name)
+{
+    fprintf(stderr, "usage: %s [-n classes] [-p page] [-a align] [-o out] [histogram]\n", name);
+
+    return 1;
+}
+
+static int read_hist(FILE* in, uint64_t* counts)
+{
+    // add every size of in to counts, one per multiple
+    // of align up to page
+    // return 0 if successful
+
+    char line[256];
+    while (fgets(line, sizeof(line), in))
+    {
+        if (line[0] == '#' || line[0] == '\n')
+        {
+            continue;
+        }
+
+        char* end;
+        unsigned long long sz = strtoull(line, &end, 0);
+        if (end == line)
+        {
+            fprintf(stderr, "bad line: %s", line);
+            return 1;
+        }
+
+        char* count_end;
+        unsigned long long count = strtoull(end, &count_end, 0);
+        if (count_end == end)
+        {
+            count = 1;
+        }
+
+        if (sz > page)
+        {
+            continue;
+        }
+
+        counts[sz ? (sz + align - 1) / align : 1] += count;
+    }
+
+    return 0;
+}
+
+static void write_header(FILE* out, const size_t* classes, size_t num, uint64_t total, uint64_t waste)
+{
+    fprintf(out, "#pragma once\n\n");
+    fprintf(out, "/*  Size classes made by tools/size_classes for a\n");
+    fprintf(out, "    histogram of %llu allocations, wasting %llu bytes.\n", (unsigned long long)total, (unsigned long long)waste);
+    fprintf(out, "    Each entry is X(index, bytes).\n");
+    fprintf(out, "*/\n");
+    fprintf(out, "#define MY_MALLOC_SIZE_CLASSES(X) \\\n");
+
+    for (size_t i = 0; i != num; ++i)
+    {
+        char entry[64];
+        snprintf(entry, sizeof(entry), "X(%zu,%*s%zu)", i, i < 10 ? 2 : 1, "", classes[i]);
+
+        if (i + 1 != num)
+        {
+            fprintf(out, "    %-12s\\\n", entry);
+        }
+        else
+        {
+            fprintf(out, "    %s\n", entry);
+        }
+    }
+
+    fprintf(out, "\n#define MY_MALLOC_NUM_CLASSES %zu\n", num);
+    fprintf(out, "\n#define MY_MALLOC_SMALL_MAX %zu\n", classes[num - 1]);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* out_name = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:p:a:o:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n':
+                num_classes = strtoull(optarg, NULL, 0);
+                break;
+            case 'p':
+                page = strtoull(optarg, NULL, 0);
+                break;
+            case 'a':
+                align = strtoull(optarg, NULL, 0);
+                break;
+            case 'o':
+                out_name = optarg;
+                break;
+            default:
+                return usage(argv[0]);
+        }
+    }
+
+    if (!num_classes || !align || page < align || optind + 1 < argc)
+    {
+        return usage(argv[0]);
+    }
+
+    // nodes are multiples of MY_MALLOC_MIN_ALIGN, a class
+    // between two never matches its node and is never cached
+    if (align % MY_MALLOC_MIN_ALIGN)
+    {
+        fprintf(stderr, "align must be a multiple of %zu\n", MY_MALLOC_MIN_ALIGN);
+        return 1;
+    }
+
+    FILE* in = optind < argc ? fopen(argv[optind], "r") : stdin;
+    if (!in)
+    {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    size_t num_bins = (page / align) + 1;
+    uint64_t* counts = calloc(num_bins, sizeof(uint64_t));
+    if (!counts || read_hist(in, counts))
+    {
+        return 1;
+    }
+
+    // distinct sizes seen, smallest first
+
+    size_t num_sizes = 0;
+    for (size_t i = 0; i != num_bins; ++i)
+    {
+        num_sizes += !!counts[i];
+    }
+    if (!num_sizes)
+    {
+        fprintf(stderr, "no sizes of atmost %zu bytes\n", page);
+        return 1;
+    }
+    if (num_classes > num_sizes)
+    {
+        num_classes = num_sizes;
+    }
+
+    size_t*   sizes = calloc(num_sizes, sizeof(size_t));
+    uint64_t* count = calloc(num_sizes + 1, sizeof(uint64_t));
+    uint64_t* bytes = calloc(num_sizes + 1, sizeof(uint64_t));
+
+    for (size_t i = 0, j = 0; i != num_bins; ++i)
+    {
+        if (counts[i])
+        {
+            // prefix sums of counts and requested bytes
+
+            sizes[j] = i * align;
+            count[j + 1] = count[j] + counts[i];
+            bytes[j + 1] = bytes[j] + (counts[i] * sizes[j]);
+            ++j;
+        }
+    }
+
+    /*  Every class is one of the sizes seen, and the
+        largest size is always a class. waste[k][j] is
+        the fewest bytes wasted by k + 1 classes with the
+        largest being sizes[j], holding every size upto
+        it. A class holding sizes i to j wastes
+            sizes[j] * count(i..j) - bytes(i..j)
+        so the best is found by trying every i.
+    */
+
+    uint64_t* waste = calloc(num_classes * num_sizes, sizeof(uint64_t));
+    size_t*   from  = calloc(num_classes * num_sizes, sizeof(size_t));
+    if (!sizes || !count || !bytes || !waste || !from)
+    {
+        return 1;
+    }
+
+    #define WASTE(I, J) \
+        ((sizes[J] * (count[(J) + 1] - count[I])) - (bytes[(J) + 1] - bytes[I]))
+
+    for (size_t j = 0; j != num_sizes; ++j)
+    {
+        waste[j] = WASTE(0, j);
+    }
+
+    for (size_t k = 1; k != num_classes; ++k)
+    {
+        for (size_t j = k; j != num_sizes; ++j)
+        {
+            uint64_t best = UINT64_MAX;
+
+            for (size_t i = k; i <= j; ++i)
+            {
+                uint64_t cost = waste[((k - 1) * num_sizes) + i - 1] + WASTE(i, j);
+                if (cost < best)
+                {
+                    best = cost;
+                    from[(k * num_sizes) + j] = i;
+                }
+            }
+
+            waste[(k * num_sizes) + j] = best;
+        }
+    }
+
+    #undef WASTE
+
+    size_t* classes = calloc(num_classes, sizeof(size_t));
+    if (!classes)
+    {
+        return 1;
+    }
+
+    for (size_t k = num_classes, j = num_sizes - 1; k--;)
+    {
+        classes[k] = sizes[j];
+        j = from[(k * num_sizes) + j] - 1;
+    }
+
+    FILE* out = out_name ? fopen(out_name, "w") : stdout;
+    if (!out)
+    {
+        perror(out_name);
+        return 1;
+    }
+
+    write_header(out, classes, num_classes, count[num_sizes], waste[((num_classes - 1) * num_sizes) + num_sizes - 1]);
+
+    return out != stdout && fclose(out);
+}